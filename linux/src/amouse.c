@@ -22,19 +22,30 @@
 #include <string.h>   // strerror()
 #include <stdint.h>   // for uint8_t
 #include <time.h>     // for time()
+#include <signal.h>   // sigaction(), latency dumps and clean exit
 
 #include "include/version.h"
 #include "include/serial.h"
 #include "include/storage.h"
+#include "include/latency.h"
+#include "include/input.h"
+#include "include/trace.h"
 #include "../../shared/console.h"
 #include "../../shared/mouse.h"
+#include "../../shared/pacing.h"
 #include "../../shared/utils.h"
 #include "../../shared/settings.h"
 
 // Linux specific
-#include <sys/ioctl.h> // ioctl (serial pins, mouse exclusive access)
-#include <libevdev.h>  // input dev
-#include <getopt.h>    // getopt
+#include <sys/ioctl.h>   // ioctl (serial pins, mouse exclusive access)
+#include <sys/epoll.h>   // epoll, event driven main loop
+#include <sys/timerfd.h> // timerfd, transmit deadlines as file descriptor
+#include <libevdev.h>    // input dev
+#include <getopt.h>      // getopt
+
+#define EPOLL_MAX_EVENTS  4
+#define EVDEV_READ_BATCH  64 // Input events read from kernel per read()
+#define MS_CTS_POLL       10 // Fallback CTS sampling interval when serial driver can't notify of pin changes
 
 
 /*** Program parameters ***/ 
@@ -43,11 +54,25 @@
 struct linux_opts {
   char *mousepath; // Pointers, memory is dynamically allocated.
   char *serialpath;
+  char *tracepath;
   int exclusive;
   int immediate;
+  int outq_pacing;
+  int latency;
   int debug;
 };
 
+static latency_stats_t latency_stats; // Packet latency histograms, recorded with -L
+static FILE *trace_file = NULL;       // Input frame and packet capture, written with -T
+
+static volatile sig_atomic_t quit_requested = 0;
+static volatile sig_atomic_t latency_dump_requested = 0;
+
+static void handle_signal(int signum) {
+  if(signum == SIGUSR1) { latency_dump_requested = 1; }
+  else { quit_requested = 1; }
+}
+
 
 /*** Linux console ***/
 
@@ -64,7 +89,15 @@ void showhelp(char *argv[]) {
     "  -r <1-30> Set mouse responsiveness/sensitivity\n" \
     "  -e Disable exclusive access to mouse\n" \
     "  -i Immediate ident mode, disables waiting for CTS pin\n" \
+    "  -q Pace transmits on serial output queue occupancy (USB-serial adapters)\n" \
     "  -l Swap left and right buttons\n" \
+    "  -L Record packet latency, histograms are printed on SIGUSR1 and at exit\n" \
+    "  -T <File> to capture input frames and serial packets to, for offline replay\n" \
+    "  -w Send 3 byte MS wheel packets while wheel and MMB are idle, for drivers that support it\n" \
+    "  -c <0-2> Carry motion over packet limits, with decay (0: none 1: halve 2: drop when stopped)\n" \
+    "  -C <0-3> Cap carried motion backlog to 256, 512, 1024 or 2048 counts\n" \
+    "  -a <0-2> Acceleration curve (0: linear 1: power 2: custom)\n" \
+    "  -A <speed:gain,..> Custom acceleration points, speed in counts per packet and gain in tenths, eg. 0:10,20:15,60:30\n" \
     "  -W Write mouse settings to ~/.amouse.conf file\n"
     "  -d Print out debug information on mouse state\n", V_MAJOR, V_MINOR, V_REVISION, argv[0]);
 }
@@ -77,6 +110,31 @@ void linux_save_settings() {
     write_flash_settings(&binary_settings[0], sizeof(binary_settings));
 }
 
+// Read speed:gain pairs for the custom acceleration curve, gain is given in tenths.
+static void parse_accel_points(char *arg) {
+  uint scan_size = strnlen(arg, 64) + 5; // scan_int() reads up to 5 digits past the number start
+  scan_int_t speed, gain;
+  int num = 0;
+
+  speed.offset = 0;
+  while(num < ACCEL_POINTS_MAX) {
+    speed = scan_int((uint8_t*)arg, speed.offset, scan_size, 3);
+    if(!speed.found) { break; }
+    gain = scan_int((uint8_t*)arg, speed.offset, scan_size, 2);
+    if(!gain.found) { break; }
+    speed.offset = gain.offset;
+
+    if(num > 0 && speed.value <= g_mouse_options.accel_points[num - 1].speed) {
+      fprintf(stderr, "Acceleration points must be in increasing speed order, ignoring rest.\n");
+      break;
+    }
+    g_mouse_options.accel_points[num].speed = clampi(speed.value, 0, ACCEL_LUT_SIZE - 1);
+    g_mouse_options.accel_points[num].gain  = clampi(SENSITIVITY_FROM_TENTHS(gain.value), 0, ACCEL_GAIN_MAX);
+    num++;
+  }
+  g_mouse_options.accel_points_num = num;
+}
+
 void parse_opts(int argc, char **argv, struct linux_opts *options) {
   int option_index = 0;
   int quit = 0;
@@ -85,7 +143,7 @@ void parse_opts(int argc, char **argv, struct linux_opts *options) {
   // Safe defaults
   g_mouse_options.wheel = 1;
   g_mouse_options.protocol = PROTO_MSWHEEL;
-  g_mouse_options.sensitivity = 1.0;
+  g_mouse_options.sensitivity = SENSITIVITY_ONE;
   options->exclusive = 1;
 
   // Attempt to load saved settings from storage
@@ -97,7 +155,7 @@ void parse_opts(int argc, char **argv, struct linux_opts *options) {
     settings_decode(&flash_memory[0], &g_mouse_options);
   }
 
-  while (( option_index = getopt(argc, argv, "hm:s:p:r:ielWd")) != -1) {
+  while (( option_index = getopt(argc, argv, "hm:s:p:r:ieqlwc:C:a:A:LT:Wd")) != -1) {
 
     switch(option_index) {
       case '?':
@@ -133,9 +191,38 @@ void parse_opts(int argc, char **argv, struct linux_opts *options) {
       case 'e':
       	options->exclusive = 0; // Computer will also get mouse inputs.
 	      break;
+      case 'q':
+        options->outq_pacing = 1; // Check real output queue depth before sending
+        break;
       case 'l':
         g_mouse_options.swap_buttons = 1;
       	break;
+      case 'w':
+        g_mouse_options.wheel_short = 1;
+        break;
+      case 'c':
+        scan_i = scan_int((uint8_t*)optarg, 0, 2, 1);
+        g_mouse_options.motion_carry = 1;
+        if(scan_i.found) { g_mouse_options.carry_decay = clampi(scan_i.value, CARRY_DECAY_NONE, CARRY_DECAY_STOP); }
+        break;
+      case 'C':
+        scan_i = scan_int((uint8_t*)optarg, 0, 2, 1);
+        if(scan_i.found) { g_mouse_options.carry_cap = clampi(scan_i.value, 0, 3); }
+        break;
+      case 'a':
+        scan_i = scan_int((uint8_t*)optarg, 0, 2, 1);
+        if(scan_i.found) { g_mouse_options.accel_curve = clampi(scan_i.value, ACCEL_LINEAR, ACCEL_CUSTOM); }
+        break;
+      case 'A':
+        parse_accel_points(optarg);
+        g_mouse_options.accel_curve = ACCEL_CUSTOM;
+        break;
+      case 'L':
+        options->latency = 1;
+        break;
+      case 'T':
+        options->tracepath = strndup(optarg, 4096);
+        break;
       case 'd':
 	      options->debug = 1; // Enable debug prints
 	      break;
@@ -147,6 +234,8 @@ void parse_opts(int argc, char **argv, struct linux_opts *options) {
     }
   }
 
+  apply_mouse_options(); // Settings are final now
+
   if(options->mousepath == NULL) { 
     fprintf(stderr, "You must define a path with -m to your mouse /dev/input/* file.\n");
     quit = 1;
@@ -184,6 +273,8 @@ static int open_usbinput(const char* device, int exclusive) {
 
   if (returncode) { 
     if(exclusive) { ioctl(fd, EVIOCGRAB, 1); } // Get exclusive mouse access
+    int clock_id = CLOCK_MONOTONIC; // Event timestamps on the same clock as our timers
+    ioctl(fd, EVIOCSCLOCKID, &clock_id);
     return fd;
   }
 
@@ -191,54 +282,171 @@ static int open_usbinput(const char* device, int exclusive) {
   return -1;
 }
 
-static inline void process_mouse_report(mouse_state_t *mouse, struct input_event const *ev, struct linux_opts *options) {
-  /** Handle mouse buttons ***/
-  if(ev->type == EV_KEY) {
-    switch(ev->code) {
-      case BTN_LEFT:
-        mouse->lmb = ev->value;
-        mouse->force_update = true;
-        push_update(mouse, mouse->mmb);
-        break;
-      case BTN_RIGHT:
-        mouse->rmb = ev->value;
-        mouse->force_update = true;
-        push_update(mouse, mouse->mmb);
-        break;
-      case BTN_MIDDLE:
-        mouse->mmb = ev->value;
-        mouse->force_update = true;
-        if(g_mouse_protocol[g_mouse_options.protocol].buttons > 2) {
-          push_update(mouse, true); // Every time MMB changes (on or off), must send 4 bytes.
-        } 
-        break;
+// After the kernel dropped events, query current button states to bring mouse state back in sync.
+static void resync_mouse_buttons(int mouse_fd, mouse_state_t *mouse, mouse_frame_t *frame) {
+  uint8_t keys[KEY_MAX / 8 + 1] = {0};
+  if(ioctl(mouse_fd, EVIOCGKEY(sizeof(keys)), keys) < 0) { return; }
+
+  int lmb = (keys[BTN_LEFT   / 8] >> (BTN_LEFT   % 8)) & 1;
+  int rmb = (keys[BTN_RIGHT  / 8] >> (BTN_RIGHT  % 8)) & 1;
+  int mmb = (keys[BTN_MIDDLE / 8] >> (BTN_MIDDLE % 8)) & 1;
+  if(lmb != mouse->lmb) { frame->lmb = lmb; }
+  if(rmb != mouse->rmb) { frame->rmb = rmb; }
+  if(mmb != mouse->mmb) { frame->mmb = mmb; }
+}
+
+
+/*** Event loop helpers ***/
+
+// Register file descriptor with epoll instance for read readiness
+static void epoll_watch(int epoll_fd, int fd) {
+  struct epoll_event event = { .events = EPOLLIN, .data.fd = fd };
+  if(epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) < 0) {
+    fprintf(stderr, "epoll_ctl() failed for fd %d: %d: %s\n", fd, errno, strerror(errno));
+    exit(-1);
+  }
+}
+
+// Arm timerfd to fire at absolute CLOCK_MONOTONIC target time, NULL disarms the timer.
+static void set_timer_target(int timer_fd, struct timespec *target) {
+  struct itimerspec timer = {0};
+  if(target != NULL) { timer.it_value = *target; }
+  if(timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &timer, NULL) < 0) {
+    fprintf(stderr, "timerfd_settime() failed: %d: %s\n", errno, strerror(errno));
+  }
+}
+
+// Send aggregated mouse state and set up timing for the next transmit
+static void transmit_mouse_state(int serial_fd, mouse_state_t *mouse, tx_schedule_t *tx_schedule, struct linux_opts *options) {
+  uint64_t time_encode = get_time_ns();
+
+  if(options->latency) { latency_tx_jitter(&latency_stats, time_encode, tx_schedule->deadline); }
+
+  encode_mouse_packet(mouse, tx_schedule, &g_serial_line, time_encode);
+
+  // Send updates
+  if(options->debug) {
+    fprintf(stderr, "Sensitivity: %d/%d\n", g_mouse_options.sensitivity, SENSITIVITY_ONE);
+    fprintf(stderr, "Next deadline: %llu\n", (unsigned long long)tx_schedule->deadline);
+    for(int i=0; i < mouse->update; i++) {
+      fprintf(stderr, "Sent %d: %x\n", i, mouse->state[i]);
+      fprintf(stderr, "Mouse state(%d): %s\n", i, byte_to_bitstring(mouse->state[i]));
     }
+    printf("\n");
   }
-  
-  /*** Handle relative movement ***/
-  else if (ev->type == EV_REL) {
-    switch(ev->code) {
-      case REL_X:
-        mouse->x += ev->value;
-        mouse->x = clampi(mouse->x, -36862, 36862);
-        push_update(mouse, mouse->mmb);
+  if(mouse->update > 0) { serial_write(serial_fd, mouse->state, mouse->update); } // Whole packet in one write
+  if(trace_file && mouse->update > 0) { trace_write_packet(trace_file, time_encode, mouse->state, mouse->update); }
+  if(options->latency && mouse->update > 0) { latency_packet(&latency_stats, time_encode, get_time_ns()); }
+
+  reset_mouse_state(mouse);
+}
+
+
+// Feed CTS pin state into driver init state machine, identify as mouse when requested.
+// Edge count from the CTS watcher tells if the pin pulsed low in between observations.
+static void handle_cts(int serial_fd, mouse_state_t *mouse, tx_schedule_t *tx_schedule, int pc_cts, uint64_t edges, struct timespec *time_ident_done, struct linux_opts *options) {
+
+  if(!pc_cts || edges > 1) { // Computers RTS low, only pin we care about for MS drivers, etc.
+    if(mouse->pc_state == CTS_UNINIT) { mouse->pc_state = CTS_LOW_INIT; }
+    else if(mouse->pc_state == CTS_TOGGLED) {
+      mouse->pc_state = CTS_LOW_RUN;
+      // Driver is no longer listening for an ident still being transmitted, abort it.
+      if(!timespec_reached(time_ident_done)) { tcflush(serial_fd, TCOFLUSH); }
+    }
+  }
+
+  // Mouse initiaizing request detected
+  if(pc_cts && (mouse->pc_state != CTS_UNINIT && mouse->pc_state != CTS_TOGGLED)) {
+    if(options->debug) {
+      aprint("Computers RTS pin toggled, identifying as mouse.\n");
+    }
+    mouse->pc_state = CTS_TOGGLED;
+    // Driver init puts the mouse back to default line rate
+    if(mouse->baud != MOUSE_BAUD_DEFAULT) {
+      serial_set_baud(serial_fd, MOUSE_BAUD_DEFAULT);
+      tx_schedule_follow_line(tx_schedule, &g_serial_line);
+    }
+    reset_line_state(mouse);
+    if(trace_file) { trace_write_ident(trace_file, get_time_ns()); }
+    mouse_ident(serial_fd, g_mouse_options.wheel);
+    int ident_len = (g_mouse_options.protocol == PROTO_MSWHEEL) ? 
+      g_pkt_intellimouse_intro_len : g_mouse_protocol[g_mouse_options.protocol].serial_ident_len;
+    *time_ident_done = get_target_time(0, line_time(&g_serial_line, ident_len));
+    reset_motion_backlog(mouse); // Drop movement aggregated while driver was not listening.
+    aprint("Mouse initialized. Good to go!\n");
+  }
+}
+
+// Apply baud and report rate requests from a Logitech driver.
+static void handle_logitech_commands(int serial_fd, mouse_state_t *mouse, tx_schedule_t *tx_schedule, uint8_t *buffer, int len, struct linux_opts *options) {
+  for(int i=0; i < len; i++) {
+    switch(logitech_command(mouse, buffer[i])) {
+      case LOGI_CMD_BAUD:
+        serial_set_baud(serial_fd, mouse->baud);
+        tx_schedule_follow_line(tx_schedule, &g_serial_line);
+        if(options->debug) { fprintf(stderr, "Logitech driver set baud: %u\n", mouse->baud); }
         break;
-      case REL_Y:
-        mouse->y += ev->value;
-        mouse->y = clampi(mouse->y, -36862, 36862);
-        push_update(mouse, mouse->mmb);
-        break;
-      case REL_WHEEL:
-        mouse->wheel += ev->value;
-        mouse->wheel = clampi(mouse->wheel, -63, 63);
-        if(g_mouse_protocol[g_mouse_options.protocol].wheel) {
-          push_update(mouse, true);
-        }
+      case LOGI_CMD_RATE:
+        if(options->debug) { fprintf(stderr, "Logitech driver set report rate: %u\n", mouse->report_rate); }
         break;
+      default:
+        continue;
     }
+    if(trace_file) { trace_write_line(trace_file, get_time_ns(), mouse); }
   }
 }
 
+// Read all pending input events from the kernel in bulk, folding each SYN_REPORT frame into mouse state.
+// Returns once the queue is empty with number of frames processed, or -1 if the device was lost.
+static int ingest_mouse_events(int mouse_fd, int serial_fd, mouse_state_t *mouse, tx_schedule_t *tx_schedule, struct linux_opts *options) {
+  static struct input_event events[EVDEV_READ_BATCH];
+  static mouse_frame_t frame = { 0, 0, 0, -1, -1, -1 }; // Frame may span multiple reads.
+  static bool frame_dropped = false;
+  ssize_t len;
+  int frames = 0;
+
+  while((len = read(mouse_fd, events, sizeof(events))) > 0) {
+    for(int i=0; i < len / (ssize_t)sizeof(struct input_event); i++) {
+      struct input_event *ev = &events[i];
+
+      if(ev->type != EV_SYN) {
+        if(!frame_dropped) { collect_mouse_event(&frame, ev); }
+        continue;
+      }
+
+      // Kernel buffer overran, discard events until next SYN_REPORT and resync buttons there.
+      if(ev->code == SYN_DROPPED) {
+        frame = empty_frame;
+        frame_dropped = true;
+        continue;
+      }
+      if(ev->code != SYN_REPORT) { continue; }
+
+      if(frame_dropped) {
+        frame = empty_frame;
+        resync_mouse_buttons(mouse_fd, mouse, &frame);
+        frame_dropped = false;
+      }
+
+      // Don't fold consecutive button changes into one packet, send out the pending one first.
+      if(frame_has_buttons(&frame) && mouse->force_update && (mouse->pc_state > CTS_LOW_INIT)) {
+        transmit_mouse_state(serial_fd, mouse, tx_schedule, options);
+      }
+
+      uint64_t time_event = (uint64_t)ev->input_event_sec * NS_FULL_SECOND + ev->input_event_usec * 1000;
+      if(options->latency) { latency_mark_event(&latency_stats, time_event); }
+      if(trace_file) { trace_write_frame(trace_file, time_event, &frame); }
+      process_mouse_report(mouse, &frame);
+      runtime_settings(mouse);
+      frame = empty_frame;
+      frames++;
+    }
+  }
+
+  if(len < 0 && errno != EAGAIN && errno != EINTR) { return -1; }
+  return frames;
+}
+
 
 /*** Main init & loop ***/
 
@@ -265,17 +473,6 @@ int main(int argc, char **argv) {
     exit(-1);
   }
 
-  struct input_event ev; // Input events
-  int returncode;
-  struct libevdev* mouse_dev;
-
-  // Create mouse device
-  returncode = libevdev_new_from_fd(mouse_fd, &mouse_dev);
-  if (returncode < 0) {
-    fprintf(stderr, "libedev_new failed: %d %s\n", -returncode, strerror(-returncode));
-    exit(-1);
-  }
-
 
   /*** Serial device ***/
   int serial_fd;
@@ -290,34 +487,78 @@ int main(int argc, char **argv) {
   }
  
   // Initialize serial parameters 
-  setup_tty(serial_fd, (speed_t)B1200);
+  setup_tty(serial_fd, MOUSE_BAUD_DEFAULT, g_mouse_protocol[g_mouse_options.protocol].data_bits);
   disable_pin(serial_fd, TIOCM_RTS | TIOCM_DTR); // We're not a modem so make sure pins low.
 
   fcntl (0, F_SETFL, O_NONBLOCK); // Nonblock 0=stdin
   setvbuf(stdout, NULL, _IONBF, 0); // Unbuffer stdout
 
   // Buffer for checking for requests from serial port. 
-  uint8_t serial_buffer[2] = {0}; 
+  uint8_t serial_buffer[16] = {0}; 
+  int serial_len;
+  int serial_pending; // Bytes still in tty output queue
   int i; // Allocate outside main loop instead of allocating every time.
 
   // Aggregate movements before sending
-  struct timespec time_rx_target, time_tx_target;
-  mouse_state_t mouse;
+  tx_schedule_t tx_schedule;
+  struct timespec time_tx_target;
+  mouse_state_t mouse = {0};
   mouse.pc_state = CTS_UNINIT;
   reset_mouse_state(&mouse); // Set packet memory to initial state
+  reset_line_state(&mouse);
+
+  // Set transmit timeline, allow lagging behind it by up to a byte before re-anchoring.
+  tx_schedule_init(&tx_schedule, get_time_ns(), line_time(&g_serial_line, 1));
+
+  // Capture input and output for offline replay
+  if(options->tracepath) {
+    if((trace_file = trace_create(options->tracepath, &g_mouse_options)) == NULL) {
+      fprintf(stderr, "Trace file open() failed: %d: %s\n", errno, strerror(errno));
+      exit(-1);
+    }
+  }
+
+  /*** Event loop ***/
+  // Main loop sleeps until there is mouse input, data on serial line or a transmit deadline.
+  int epoll_fd = epoll_create1(0);
+  if(epoll_fd < 0) {
+    fprintf(stderr, "epoll_create1() failed: %d: %s\n", errno, strerror(errno));
+    exit(-1);
+  }
+  int timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+  if(timer_fd < 0) {
+    fprintf(stderr, "timerfd_create() failed: %d: %s\n", errno, strerror(errno));
+    exit(-1);
+  }
+  epoll_watch(epoll_fd, mouse_fd);
+  epoll_watch(epoll_fd, serial_fd);
+  epoll_watch(epoll_fd, timer_fd);
+
+  // Pseudo-terminals have no modem control lines, there is no CTS to follow then.
+  bool cts_lines = (get_pin(serial_fd, TIOCM_CTS) >= 0);
+  if(!cts_lines) { aprint("Serial device has no modem control lines, use -i to identify as mouse.\n"); }
+
+  // Get notified of CTS edges instead of polling pin state, if serial driver supports it.
+  cts_watcher_t cts_watcher = { .event_fd = -1, .active = false };
+  if(cts_lines && cts_watcher_start(&cts_watcher, serial_fd)) {
+    epoll_watch(epoll_fd, cts_watcher.event_fd);
+  }
 
-  // Set timers
-  time_tx_target = get_target_time(0, NS_SERIALDELAY_3B);
-  time_rx_target = get_target_time(1, 0);
+  struct epoll_event events[EPOLL_MAX_EVENTS];
+  struct timespec time_ident_done = {0};
+  uint64_t timer_expirations;
+  uint64_t cts_edges;
+  int nfds;
   
   aprint("Selected mouse protocol: "); printf("%s\n", g_mouse_protocol[g_mouse_options.protocol].name);
-  itoa((int)(g_mouse_options.sensitivity * 10), itoa_buffer, sizeof(itoa_buffer) - 1);
+  itoa(SENSITIVITY_TO_TENTHS(g_mouse_options.sensitivity), itoa_buffer, sizeof(itoa_buffer) - 1);
   aprint("Mouse sensitiviy set to "); printf("%s.\n", itoa_buffer);
   aprint("Waiting for PC to initialize mouse driver..\n");
 
   // Ident immediately on program start up.
   if(options->immediate) {
     aprint("Performing immediate identification as mouse.\n");
+    if(trace_file) { trace_write_ident(trace_file, get_time_ns()); }
     mouse_ident(serial_fd, g_mouse_options.wheel);
     mouse.pc_state = CTS_TOGGLED; // Bypass CTS detection, send events straight away.
   }
@@ -325,79 +566,103 @@ int main(int argc, char **argv) {
   /*** Main loop ***/
   bool pc_cts = false;
 
-  while(1) {
+  // Initial CTS state, later changes come from watcher.
+  if(cts_lines) { handle_cts(serial_fd, &mouse, &tx_schedule, get_pin(serial_fd, TIOCM_CTS), 0, &time_ident_done, options); }
+
+  // First SIGINT/SIGTERM exits cleanly, a second one (eg. stuck in console) uses default handling.
+  struct sigaction sa = {0};
+  sa.sa_handler = handle_signal;
+  sa.sa_flags = SA_RESETHAND;
+  sigaction(SIGINT, &sa, NULL);
+  sigaction(SIGTERM, &sa, NULL);
+  sa.sa_flags = 0;
+  sigaction(SIGUSR1, &sa, NULL);
+
+  while(!quit_requested) {
 
-    // Check for request for serial console
-    // Repeating non-blocking reads is slow so instead we queue checks every now and then with timer.
-    if(timespec_reached(&time_rx_target)) {
-      if(serial_read(serial_fd, serial_buffer, 1) > 0) {
-        if(serial_buffer[0] == '\b') {
+    if(latency_dump_requested) {
+      latency_dump_requested = 0;
+      if(options->latency) { latency_print(stdout, &latency_stats); }
+    }
+
+    // Without the watcher, wake up at intervals to sample CTS pin state.
+    nfds = epoll_wait(epoll_fd, events, EPOLL_MAX_EVENTS, (cts_watcher.active || !cts_lines) ? -1 : MS_CTS_POLL);
+    if(nfds < 0 && errno != EINTR) {
+      fprintf(stderr, "epoll_wait() failed: %d: %s\n", errno, strerror(errno));
+      break;
+    }
+
+    for(i=0; i < nfds; i++) {
+      // Check for request for serial console
+      if(events[i].data.fd == serial_fd) {
+        serial_len = serial_read(serial_fd, serial_buffer, sizeof(serial_buffer));
+        if(serial_len > 0 && console_requested(serial_buffer, serial_len)) {
           aprint("Console requested from serial line, suspending adapter.\n");
           console(serial_fd);
+          tx_schedule_follow_line(&tx_schedule, &g_serial_line); // Protocol may have changed line format
           aprint("Serial console closed, resuming adapter.\n");
+          if(trace_file) { trace_write_settings(trace_file, get_time_ns(), &g_mouse_options); }
+        }
+        else if(g_mouse_options.protocol == PROTO_LOGITECH) {
+          handle_logitech_commands(serial_fd, &mouse, &tx_schedule, serial_buffer, serial_len, options);
         }
       }
-      time_rx_target = get_target_time(1, 0); 
+      // Transmit deadline reached, acknowledge timer and fall through to transmit below.
+      else if(events[i].data.fd == timer_fd) {
+        if(read(timer_fd, &timer_expirations, sizeof(timer_expirations)) < 0) { timer_expirations = 0; }
+      }
+      // CTS pin changed
+      else if(events[i].data.fd == cts_watcher.event_fd) {
+        cts_edges = cts_watcher_edges(&cts_watcher);
+        pc_cts = get_pin(serial_fd, TIOCM_CTS);
+        handle_cts(serial_fd, &mouse, &tx_schedule, pc_cts, cts_edges, &time_ident_done, options);
+      }
     }
 
 
     // Mouse handling
 
-    pc_cts = get_pin(serial_fd, TIOCM_CTS);
-
-    if(!pc_cts) { // Computers RTS low, only pin we care about for MS drivers, etc.
-      if(mouse.pc_state == CTS_UNINIT) { mouse.pc_state = CTS_LOW_INIT; }
-      else if(mouse.pc_state == CTS_TOGGLED) { mouse.pc_state = CTS_LOW_RUN; }
+    if(cts_lines && !cts_watcher.active) {
+      pc_cts = get_pin(serial_fd, TIOCM_CTS);
+      handle_cts(serial_fd, &mouse, &tx_schedule, pc_cts, 0, &time_ident_done, options);
     }
 
-    // Mouse initiaizing request detected
-    if(pc_cts && (mouse.pc_state != CTS_UNINIT && mouse.pc_state != CTS_TOGGLED)) {
-      if(options->debug) {
-      	aprint("Computers RTS pin toggled, identifying as mouse.\n");
-      }
-      mouse.pc_state = CTS_TOGGLED;
-      mouse_ident(serial_fd, g_mouse_options.wheel);
-      aprint("Mouse initialized. Good to go!\n");
+    // Drain all pending input events, epoll is level triggered and would keep waking us up otherwise.
+    if(ingest_mouse_events(mouse_fd, serial_fd, &mouse, &tx_schedule, options) < 0) {
+      fprintf(stderr, "Mouse device lost: %d: %s\n", errno, strerror(errno));
+      break;
     }
 
     // Transmit only once we are initialized at least once. Unlike in DOS, Windows drivers will set CTS pin 
     // low after init which would inhibit transmitting. We will trust the driver to re-init if needed.
-    if((mouse.pc_state > CTS_LOW_INIT) && 
-      (libevdev_next_event(mouse_dev, LIBEVDEV_READ_FLAG_NORMAL, &ev) == LIBEVDEV_READ_STATUS_SUCCESS)) {
-
-      process_mouse_report(&mouse, &ev, options);
-      runtime_settings(&mouse);
-
+    if(mouse.pc_state > CTS_LOW_INIT) {
       /*** Send mouse state updates clamped to baud max rate ***/ 
-      if((timespec_reached(&time_tx_target) && mouse.update > -1) || mouse.force_update) {
-      	input_sensitivity(&mouse);
-        update_mouse_state(&mouse);
-         
-        // Send updates
-        if(options->debug) { fprintf(stderr, "Sensitivity: %f\n", g_mouse_options.sensitivity); }
-          for(i=0; i < mouse.update; i++) {
-            if(options->debug) {
-              fprintf(stderr, "Time: %d.%d\n", (int)time_tx_target.tv_sec, (int)time_tx_target.tv_nsec);
-              fprintf(stderr, "Sent(ev:%d) %d: %x\n", ev.code, i, mouse.state[i]);
-              fprintf(stderr, "Mouse state(%d): %s\n", i, byte_to_bitstring(mouse.state[i]));
-          }
-          serial_write(serial_fd, &mouse.state[i], sizeof(uint8_t));
+      // Button changes are sent out immediately.
+      if((mouse.update > -1 && tx_schedule_due(&tx_schedule, get_time_ns())) || mouse.force_update) {
+        // Only build the packet once the line can take it, keep aggregating until queue has drained.
+        if(options->outq_pacing && !mouse.force_update && (serial_pending = serial_outq(serial_fd)) > 0) {
+          tx_schedule_defer(&tx_schedule, get_time_ns(), line_time(&g_serial_line, serial_pending));
+        }
+        else {
+          transmit_mouse_state(serial_fd, &mouse, &tx_schedule, options);
         }
-        if(options->debug) { printf("\n"); }
-
-        // Use different send rate depending on protocol used (3 or 4 byte)
-        if(mouse.update > 3) { time_tx_target = get_target_time(0, NS_SERIALDELAY_4B); }
-        else                 { time_tx_target = get_target_time(0, NS_SERIALDELAY_3B); }
-
-        reset_mouse_state(&mouse);
       }
+
+      // Only wake up for the next transmit slot if there is something left to send.
+      time_tx_target = ns_to_timespec(tx_schedule.deadline);
+      set_timer_target(timer_fd, (mouse.update > -1) ? &time_tx_target : NULL);
     }
-    usleep(1);
   }
 
+  if(options->latency) { latency_print(stdout, &latency_stats); }
+  if(trace_file) { fclose(trace_file); }
+
+  serial_waitfor_tx(serial_fd, U_FULL_SECOND);
   disable_pin(serial_fd, TIOCM_RTS | TIOCM_DTR);
 
   if(options->exclusive) { ioctl(mouse_fd, EVIOCGRAB, 0); } // Release exclusive mouse access
+  close(timer_fd);
+  close(epoll_fd);
   close(serial_fd);
 
   free(options);
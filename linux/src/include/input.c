@@ -0,0 +1,97 @@
+/*
+ * Anachro Mouse, a usb to serial mouse adaptor. Copyright (C) 2025 Aviancer <oss+amouse@skyvian.me>
+ *
+ * This library is free software; you can redistribute it and/or modify it under the terms of the 
+ * GNU Lesser General Public License as published by the Free Software Foundation; either version 
+ * 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without 
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the 
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with this library; 
+ * if not, write to the Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*/
+
+/* input.c: evdev frames into mouse state and packets, shared by amouse and trace replay */
+
+#include "input.h"
+
+const mouse_frame_t empty_frame = { 0, 0, 0, -1, -1, -1 };
+
+void collect_mouse_event(mouse_frame_t *frame, struct input_event const *ev) {
+  /** Handle mouse buttons ***/
+  if(ev->type == EV_KEY) {
+    switch(ev->code) {
+      case BTN_LEFT:   frame->lmb = ev->value; break;
+      case BTN_RIGHT:  frame->rmb = ev->value; break;
+      case BTN_MIDDLE: frame->mmb = ev->value; break;
+    }
+  }
+  
+  /*** Handle relative movement ***/
+  else if (ev->type == EV_REL) {
+    switch(ev->code) {
+      case REL_X:     frame->x     += ev->value; break;
+      case REL_Y:     frame->y     += ev->value; break;
+      case REL_WHEEL: frame->wheel += ev->value; break;
+    }
+  }
+}
+
+bool frame_has_buttons(mouse_frame_t const *frame) {
+  return (frame->lmb >= 0 || frame->rmb >= 0 || frame->mmb >= 0);
+}
+
+void process_mouse_report(mouse_state_t *mouse, mouse_frame_t const *frame) {
+  /** Handle mouse buttons ***/
+  if(frame->lmb >= 0) {
+    mouse->lmb = frame->lmb;
+    mouse->force_update = true;
+    push_update(mouse, mouse->mmb);
+  }
+  if(frame->rmb >= 0) {
+    mouse->rmb = frame->rmb;
+    mouse->force_update = true;
+    push_update(mouse, mouse->mmb);
+  }
+  if(frame->mmb >= 0) {
+    mouse->mmb = frame->mmb;
+    mouse->force_update = true;
+    if(g_mouse_protocol[g_mouse_options.protocol].buttons > 2) {
+      push_update(mouse, true); // Every time MMB changes (on or off), must send 4 bytes.
+    } 
+  }
+
+  /*** Handle relative movement ***/
+  // Clamp to larger than valid protocol output values to allow for sensitivity scaling.
+  if(frame->x) {
+    mouse->x += frame->x;
+    mouse->x = clampi(mouse->x, -36862, 36862);
+    push_update(mouse, mouse->mmb);
+  }
+  if(frame->y) {
+    mouse->y += frame->y;
+    mouse->y = clampi(mouse->y, -36862, 36862);
+    push_update(mouse, mouse->mmb);
+  }
+  if(frame->wheel) {
+    mouse->wheel += frame->wheel;
+    mouse->wheel = clampi(mouse->wheel, -63, 63);
+    if(g_mouse_protocol[g_mouse_options.protocol].wheel) {
+      push_update(mouse, true);
+    }
+  }
+}
+
+// Packet pipeline: encode aggregated state into mouse->state and account its line time on the transmit 
+// timeline. Caller writes out mouse->update bytes, if any, and resets mouse state.
+void encode_mouse_packet(mouse_state_t *mouse, tx_schedule_t *tx_schedule, serial_line_t *line, uint64_t now) {
+  input_sensitivity(mouse);
+  update_mouse_state(mouse);
+
+  // Packet takes its line time at current format, or longer if driver limited report rate
+  if(mouse->update > 0) {
+    tx_schedule_advance(tx_schedule, now, packet_interval(mouse, line_airtime(line, mouse->update), NS_FULL_SECOND));
+  }
+}
@@ -0,0 +1,44 @@
+/*
+ * Anachro Mouse, a usb to serial mouse adaptor. Copyright (C) 2025 Aviancer <oss+amouse@skyvian.me>
+ *
+ * This library is free software; you can redistribute it and/or modify it under the terms of the 
+ * GNU Lesser General Public License as published by the Free Software Foundation; either version 
+ * 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without 
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the 
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with this library; 
+ * if not, write to the Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*/
+
+#ifndef INPUT_H_
+#define INPUT_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <linux/input.h>
+
+#include "../../../shared/mouse.h"
+#include "../../../shared/pacing.h"
+
+// Input events collected between two SYN_REPORTs, applied to mouse state as one unit.
+typedef struct mouse_frame {
+  int x, y, wheel;
+  int lmb, rmb, mmb; // Button state, -1 when unchanged within frame.
+} mouse_frame_t;
+
+extern const mouse_frame_t empty_frame;
+
+/* Functions */
+
+void collect_mouse_event(mouse_frame_t *frame, struct input_event const *ev);
+
+bool frame_has_buttons(mouse_frame_t const *frame);
+
+void process_mouse_report(mouse_state_t *mouse, mouse_frame_t const *frame);
+
+void encode_mouse_packet(mouse_state_t *mouse, tx_schedule_t *tx_schedule, serial_line_t *line, uint64_t now);
+
+#endif // INPUT_H_
@@ -0,0 +1,91 @@
+/*
+ * Anachro Mouse, a usb to serial mouse adaptor. Copyright (C) 2025 Aviancer <oss+amouse@skyvian.me>
+ *
+ * This library is free software; you can redistribute it and/or modify it under the terms of the 
+ * GNU Lesser General Public License as published by the Free Software Foundation; either version 
+ * 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without 
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the 
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with this library; 
+ * if not, write to the Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*/
+
+/* latency.c: Packet latency histograms */
+
+#include "latency.h"
+
+    /*
+     *  Recording is a bucket increment, cheap enough to leave on for long runs. Percentiles are 
+     *  resolved to bucket upper bounds, so p50/p99 are within a factor of two while max is exact.
+    */
+
+static const char *stage_names[LAT_STAGES] = {
+  "event to encode",
+  "encode to write",
+  "event to write",
+  "tx jitter"
+};
+
+void latency_record(latency_hist_t *hist, uint64_t ns) {
+  uint64_t us = ns / 1000;
+  int bucket = 0;
+
+  while(us > 0 && bucket < LATENCY_BUCKETS - 1) { us >>= 1; bucket++; }
+  hist->buckets[bucket]++;
+  hist->count++;
+  if(ns > hist->max) { hist->max = ns; }
+}
+
+// Input event is going into the pending packet, only the oldest one is measured.
+void latency_mark_event(latency_stats_t *stats, uint64_t event_ns) {
+  if(stats->event_ns == 0) { stats->event_ns = event_ns; }
+}
+
+// Packet was encoded and written, record stages against the oldest event in it.
+void latency_packet(latency_stats_t *stats, uint64_t encode_ns, uint64_t write_ns) {
+  if(stats->event_ns > 0 && encode_ns >= stats->event_ns) {
+    latency_record(&stats->hist[LAT_EVENT_TO_ENCODE], encode_ns - stats->event_ns);
+    latency_record(&stats->hist[LAT_EVENT_TO_WRITE], write_ns - stats->event_ns);
+  }
+  latency_record(&stats->hist[LAT_ENCODE_TO_WRITE], write_ns - encode_ns);
+  stats->event_ns = 0;
+}
+
+// Record how late a packet went out compared to when it became sendable: the later of its deadline 
+// and its oldest event. Idle gaps where the deadline expired long before any input don't count, 
+// neither do early packets (button changes). Call before latency_packet().
+void latency_tx_jitter(latency_stats_t *stats, uint64_t encode_ns, uint64_t deadline_ns) {
+  uint64_t ready_ns = (stats->event_ns > deadline_ns) ? stats->event_ns : deadline_ns;
+  if(encode_ns >= ready_ns) { latency_record(&stats->hist[LAT_TX_JITTER], encode_ns - ready_ns); }
+}
+
+// Upper bound in nanoseconds of the bucket holding given percentile (permille, eg. 990 for p99).
+uint64_t latency_percentile(const latency_hist_t *hist, int permille) {
+  uint64_t target = (hist->count * permille + 999) / 1000;
+  uint64_t seen = 0;
+
+  if(hist->count == 0) { return 0; }
+  for(int i=0; i < LATENCY_BUCKETS; i++) {
+    seen += hist->buckets[i];
+    if(seen >= target) { 
+      uint64_t bound = (1ULL << i) * 1000;
+      return (bound < hist->max) ? bound : hist->max;
+    }
+  }
+  return hist->max;
+}
+
+void latency_print(FILE *out, const latency_stats_t *stats) {
+  fprintf(out, "%-16s %10s %10s %10s %10s\n", "Latency (us)", "packets", "p50", "p99", "max");
+  for(int i=0; i < LAT_STAGES; i++) {
+    const latency_hist_t *hist = &stats->hist[i];
+    fprintf(out, "%-16s %10llu %10llu %10llu %10llu\n", stage_names[i],
+      (unsigned long long)hist->count,
+      (unsigned long long)latency_percentile(hist, 500) / 1000,
+      (unsigned long long)latency_percentile(hist, 990) / 1000,
+      (unsigned long long)hist->max / 1000);
+  }
+}
@@ -0,0 +1,59 @@
+/*
+ * Anachro Mouse, a usb to serial mouse adaptor. Copyright (C) 2025 Aviancer <oss+amouse@skyvian.me>
+ *
+ * This library is free software; you can redistribute it and/or modify it under the terms of the 
+ * GNU Lesser General Public License as published by the Free Software Foundation; either version 
+ * 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without 
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the 
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with this library; 
+ * if not, write to the Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*/
+
+#ifndef LATENCY_H_
+#define LATENCY_H_
+
+#include <stdio.h>
+#include <stdint.h>
+
+// Log2 buckets of microseconds, bucket 0 is below 1us and bucket i holds [2^(i-1), 2^i) us.
+#define LATENCY_BUCKETS 32
+
+typedef struct latency_hist {
+  uint64_t buckets[LATENCY_BUCKETS];
+  uint64_t count;
+  uint64_t max; // Nanoseconds
+} latency_hist_t;
+
+// Measured stages of a packet, timestamps are CLOCK_MONOTONIC nanoseconds.
+enum LATENCY_STAGES {
+  LAT_EVENT_TO_ENCODE = 0, // Oldest input event in packet until packet is encoded, includes pacing wait
+  LAT_ENCODE_TO_WRITE = 1, // Encoding and write() to tty
+  LAT_EVENT_TO_WRITE  = 2, // End to end
+  LAT_TX_JITTER       = 3, // How late a paced packet went out compared to its deadline
+  LAT_STAGES          = 4
+};
+
+typedef struct latency_stats {
+  latency_hist_t hist[LAT_STAGES];
+  uint64_t event_ns; // Time of oldest input event waiting for the next packet, 0 if none.
+} latency_stats_t;
+
+/* Functions */
+
+void latency_record(latency_hist_t *hist, uint64_t ns);
+
+void latency_mark_event(latency_stats_t *stats, uint64_t event_ns);
+
+void latency_packet(latency_stats_t *stats, uint64_t encode_ns, uint64_t write_ns);
+
+void latency_tx_jitter(latency_stats_t *stats, uint64_t encode_ns, uint64_t deadline_ns);
+
+uint64_t latency_percentile(const latency_hist_t *hist, int permille);
+
+void latency_print(FILE *out, const latency_stats_t *stats);
+
+#endif // LATENCY_H_
@@ -21,7 +21,11 @@
 #include <stdint.h> // for uint8_t
 #include <time.h> // for time()
 
-#include <sys/ioctl.h> // ioctl (serial pins, mouse exclusive access)
+#include <poll.h>        // poll(), waiting for room in tty buffer
+#include <sys/uio.h>     // writev()
+#include <sys/ioctl.h>   // ioctl (serial pins, mouse exclusive access)
+#include <sys/eventfd.h> // eventfd, CTS watcher notifications
+#include <linux/serial.h> // serial_icounter_struct
 
 #include "serial.h"
 #include "wrappers.h"
@@ -29,51 +33,126 @@
 
 /*** Serial comms ***/
 
+#define TERMINAL_IOV_LEN 32 // Staged output segments per writev()
+
+static const uint8_t chr_carriage_return = (uint8_t)'\r';
+
+serial_line_t g_serial_line; // Line timing in nanoseconds
+
+static speed_t baud_to_speed(uint32_t baud) {
+  switch(baud) {
+    case 2400: return B2400;
+    case 4800: return B4800;
+    case 9600: return B9600;
+    default:   return B1200;
+  }
+}
+
+// Write all staged segments, waiting for room in tty buffer if the non-blocking fd fills up.
+static int serial_writev_all(int fd, struct iovec *iov, int iovcnt) {
+  int total = 0;
+  ssize_t written;
+  struct pollfd pfd = { .fd = fd, .events = POLLOUT };
+
+  while(iovcnt > 0) {
+    written = writev(fd, iov, iovcnt);
+    if(written < 0) {
+      if(errno == EAGAIN || errno == EINTR) { poll(&pfd, 1, 100); continue; }
+      return -1;
+    }
+    total += written;
+
+    // Skip fully written segments, adjust partially written one.
+    while(iovcnt > 0 && (size_t)written >= iov->iov_len) {
+      written -= iov->iov_len;
+      iov++;
+      iovcnt--;
+    }
+    if(iovcnt > 0) {
+      iov->iov_base = (uint8_t*)iov->iov_base + written;
+      iov->iov_len -= written;
+    }
+  }
+  return total;
+}
+
+// Packets must go out whole, a partial write or EAGAIN on the non-blocking fd is completed here.
 int serial_write(int fd, uint8_t *buffer, int size) { 
-  return write(fd, buffer, size);
+  struct iovec iov = { .iov_base = buffer, .iov_len = size };
+  return serial_writev_all(fd, &iov, 1);
 }
 
 /* Write to serial out with enforced order, convert terminal characters */
+// Output is staged as segments of buffer with CR inserted before each LF, flushed with writev().
 int serial_write_terminal(int fd, uint8_t *buffer, int size) { 
-  int bytes=0;
-  for(; bytes < size; bytes++) {
-    if(buffer[bytes] == '\0') { return bytes; }
+  struct iovec iov[TERMINAL_IOV_LEN];
+  int iovcnt = 0;
+  int start = 0;
+  int bytes = 0;
+
+  for(; bytes < size && buffer[bytes] != '\0'; bytes++) {
     // Convert LF to CRLF
-    else if(buffer[bytes] == '\n') {
-      write(fd, "\r", 1);
+    if(buffer[bytes] != '\n') { continue; }
+
+    if(bytes > start) {
+      iov[iovcnt].iov_base = &buffer[start];
+      iov[iovcnt].iov_len  = bytes - start;
+      iovcnt++;
+    }
+    iov[iovcnt].iov_base = (void*)&chr_carriage_return;
+    iov[iovcnt].iov_len  = 1;
+    iovcnt++;
+    start = bytes; // LF goes out with next segment
+
+    // Keep room for two segments per linebreak
+    if(iovcnt >= TERMINAL_IOV_LEN - 1) {
+      serial_writev_all(fd, iov, iovcnt);
+      iovcnt = 0;
     }
-    write(fd, &buffer[bytes], 1);
-  }  
+  }
+  if(bytes > start) {
+    iov[iovcnt].iov_base = &buffer[start];
+    iov[iovcnt].iov_len  = bytes - start;
+    iovcnt++;
+  }
+  if(iovcnt > 0) { serial_writev_all(fd, iov, iovcnt); }
+
   return bytes;
 }
 
+// Number of bytes still waiting in the tty output queue, -1 on error.
+// Note that USB-serial adapters may hold a few more bytes in their own FIFO.
+int serial_outq(int fd) {
+  int pending = 0;
+  if(ioctl(fd, TIOCOUTQ, &pending) < 0) { return -1; }
+  return pending;
+}
+
 // Wait for any current serial transmission to be done
 // Allows defining max_wait_us for timeout
-bool serial_waitfor_tx(uint32_t max_wait_us) {
+bool serial_waitfor_tx(int fd, uint32_t max_wait_us) {
 
   struct timespec time_timeout;
   time_timeout = get_target_time(0, max_wait_us * 1000); // Convert from micro to nanoseconds
 
-  do {
-    a_usleep(10);
-
+  int pending;
+  while((pending = serial_outq(fd)) != 0) {
+    if(pending < 0) { break; } // Can't tell, let tcdrain() handle it.
     if(timespec_reached(&time_timeout)) {
       return false; // Timed out
     }
+    // Sleep roughly until queued bytes are out, capped to not overshoot timeout too much.
+    a_usleep(line_time(&g_serial_line, (pending < 10) ? pending : 10) / 1000);
+  }
 
-  } while(1); // TODO: Check queue
-
+  tcdrain(fd); // Wait out the last byte still in the shift register
   return true; // Finished within timeout
 }
 
-// Non-blocking read
+// Non-blocking read, returns whatever is available up to size in one call.
 int serial_read(int fd, uint8_t *buffer, int size) {
-  int bytes=0;
-  for(int i=0; i < size; i++) {
-    if(read(fd, &buffer[bytes], 1) > 0) { bytes++; }
-    else { break; }
-  }
-  return bytes;
+  ssize_t bytes = read(fd, buffer, size);
+  return (bytes > 0) ? bytes : 0;
 }
 
 int get_pin(int fd, int flag) {
@@ -103,21 +182,21 @@ int disable_pin(int fd, int flag) {
   return 0;
 }
 
-int setup_tty(int fd, speed_t baudrate) {
+int setup_tty(int fd, uint32_t baud, int data_bits) {
   struct termios tty;
   tcgetattr(fd, &tty);
 
   /* Set baud rate */
-  cfsetospeed(&tty, (speed_t)baudrate); // tty needs to be pointer
-  cfsetispeed(&tty, (speed_t)baudrate); // tty needs to be pointer
+  cfsetospeed(&tty, baud_to_speed(baud)); // tty needs to be pointer
+  cfsetispeed(&tty, baud_to_speed(baud)); // tty needs to be pointer
   
   cfmakeraw(&tty); // Make tty raw, needs to be pointer
 
   /* Setting other Port Stuff, note: "->" for pointer, "." for direct ref */
-  tty.c_cflag     &=  ~PARENB;            // Make 7n1
+  tty.c_cflag     &=  ~PARENB;            // Make 7n1 or 8n1
   tty.c_cflag     &=  ~CSTOPB;            // 1 stop bit
   tty.c_cflag     &=  ~CSIZE;
-  tty.c_cflag     |=  CS7;                // CS7=7bit, CS8=8bit
+  tty.c_cflag     |=  (data_bits == 8) ? CS8 : CS7; // CS7=7bit, CS8=8bit
   
   tty.c_cflag     &=  ~CRTSCTS;           // no flow control
   tty.c_cc[VMIN]   =  1;                  // read doesn't block  (optional)
@@ -130,9 +209,38 @@ int setup_tty(int fd, speed_t baudrate) {
     return -1;
   }
 
+  line_init(&g_serial_line, NS_FULL_SECOND, baud, data_bits, 0, 1);
   return 0;
 }
 
+// Switch between 7N1 and 8N1, after anything already queued has gone out in the previous format.
+void serial_set_data_bits(int fd, int data_bits) {
+  struct termios tty;
+  if(tcgetattr(fd, &tty) != 0) { return; }
+
+  tty.c_cflag &= ~CSIZE;
+  tty.c_cflag |= (data_bits == 8) ? CS8 : CS7;
+  if(tcsetattr(fd, TCSADRAIN, &tty) != 0) {
+    printf("tcsetattr() failed: %d: %s\n", errno, strerror(errno));
+    return;
+  }
+  line_set_format(&g_serial_line, data_bits, 0, 1);
+}
+
+// Change line rate for host requested baud, after anything already queued has gone out at the old rate.
+void serial_set_baud(int fd, uint32_t baud) {
+  struct termios tty;
+  if(tcgetattr(fd, &tty) != 0) { return; }
+
+  cfsetospeed(&tty, baud_to_speed(baud));
+  cfsetispeed(&tty, baud_to_speed(baud));
+  if(tcsetattr(fd, TCSADRAIN, &tty) != 0) {
+    printf("tcsetattr() failed: %d: %s\n", errno, strerror(errno));
+    return;
+  }
+  line_set_baud(&g_serial_line, baud);
+}
+
 void wait_pin_state(int fd, int flag, int desired_state) {
   // Monitor
   int pin_state = -1;
@@ -142,13 +250,11 @@ void wait_pin_state(int fd, int flag, int desired_state) {
   }
 }
 
+// Ident gets written to the tty buffer in one go. If driver drops CTS while ident is still being
+// transmitted, caller is expected to flush remaining output (tcflush) to abort it.
 void mouse_ident(int fd, bool wheel_enabled) {
   if(g_mouse_options.protocol == PROTO_MSWHEEL) {
-    int bytes=0;
-    for(; bytes < g_pkt_intellimouse_intro_len; bytes++) {
-      if(!get_pin(fd, TIOCM_CTS)) { break; }
-      write(fd, &g_pkt_intellimouse_intro[bytes], 1);
-    }
+    write(fd, g_pkt_intellimouse_intro, g_pkt_intellimouse_intro_len);
   }
   else {
     write(
@@ -159,6 +265,69 @@ void mouse_ident(int fd, bool wheel_enabled) {
   }
 }
 
+/*** CTS watcher ***/
+
+// Blocks in TIOCMIWAIT until CTS changes, then signals number of edges through eventfd.
+// Edges are counted with TIOCGICOUNT so that short pulses between wakeups are not lost.
+static void* cts_watcher_thread(void *arg) {
+  cts_watcher_t *watcher = (cts_watcher_t*)arg;
+  struct serial_icounter_struct icount;
+  uint64_t edges;
+  int prev_cts = -1;
+
+  if(ioctl(watcher->fd, TIOCGICOUNT, &icount) == 0) { prev_cts = icount.cts; }
+
+  while(1) {
+    if(ioctl(watcher->fd, TIOCMIWAIT, TIOCM_CTS) < 0) {
+      if(errno == EINTR) { continue; }
+      // Not supported by driver (eg. pty), wake up main loop to fall back to polling.
+      watcher->active = false;
+      edges = 1;
+      write(watcher->event_fd, &edges, sizeof(edges));
+      return NULL;
+    }
+
+    if(prev_cts >= 0 && ioctl(watcher->fd, TIOCGICOUNT, &icount) == 0) {
+      edges = icount.cts - prev_cts;
+      prev_cts = icount.cts;
+    }
+    else { edges = 1; }
+
+    if(edges > 0) { write(watcher->event_fd, &edges, sizeof(edges)); }
+  }
+  return NULL;
+}
+
+// Start watching CTS edges on fd, watcher->event_fd becomes readable on changes.
+// Returns false if the watcher could not be started and caller should poll pin state instead.
+bool cts_watcher_start(cts_watcher_t *watcher, int fd) {
+  watcher->fd = fd;
+  watcher->active = false;
+  watcher->event_fd = eventfd(0, EFD_NONBLOCK);
+  if(watcher->event_fd < 0) {
+    printf("eventfd() failed: %d: %s\n", errno, strerror(errno));
+    return false;
+  }
+
+  watcher->active = true;
+  if(pthread_create(&watcher->thread, NULL, cts_watcher_thread, watcher) != 0) {
+    printf("pthread_create() failed for CTS watcher\n");
+    watcher->active = false;
+    close(watcher->event_fd);
+    watcher->event_fd = -1;
+    return false;
+  }
+  pthread_detach(watcher->thread);
+  return true;
+}
+
+// Consume pending notifications, returns number of CTS edges seen since last call.
+uint64_t cts_watcher_edges(cts_watcher_t *watcher) {
+  uint64_t edges = 0;
+  if(read(watcher->event_fd, &edges, sizeof(edges)) < 0) { return 0; }
+  return edges;
+}
+
 void timespec_diff(struct timespec *ts1, struct timespec *ts2, struct timespec *result) {
   result->tv_sec  = ts1->tv_sec  - ts2->tv_sec;
   result->tv_nsec = ts1->tv_nsec - ts2->tv_nsec;
@@ -177,15 +346,28 @@ bool timespec_reached(struct timespec *target) {
   return(time.tv_nsec >= target->tv_nsec);
 }
 
+uint64_t timespec_to_ns(struct timespec *ts) {
+  return (uint64_t)ts->tv_sec * NS_FULL_SECOND + ts->tv_nsec;
+}
+
+struct timespec ns_to_timespec(uint64_t ns) {
+  struct timespec ts;
+  ts.tv_sec  = ns / NS_FULL_SECOND;
+  ts.tv_nsec = ns % NS_FULL_SECOND;
+  return(ts);
+}
+
+// Current CLOCK_MONOTONIC time in nanoseconds
+uint64_t get_time_ns() {
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return timespec_to_ns(&time);
+}
+
 struct timespec get_target_time(uint8_t seconds, uint32_t nseconds) {
   struct timespec time, target;
   clock_gettime(CLOCK_MONOTONIC, &time);
-  
-  // 1200 baud (bits/s) is 133.333333333... bytes/s
-  // 44.44.. updates per second with 3 bytes.
-  // 33.25.. updates per second with 4 bytes.
-  // ~0.0075 seconds per byte, target time calculated for 4 bytes
-  
+
   target.tv_sec  = time.tv_sec + seconds + ((time.tv_nsec + nseconds) / NS_FULL_SECOND); 
   target.tv_nsec = (time.tv_nsec + nseconds) % NS_FULL_SECOND; 
 
@@ -18,12 +18,28 @@
 
 #include <termios.h> // POSIX terminal control defs
 #include <stdbool.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "../../../shared/pacing.h"
+
+// Background watcher for CTS pin edges, avoids polling pin state with ioctls.
+typedef struct cts_watcher {
+  int fd;              // Serial device being watched
+  int event_fd;        // eventfd, counter is increased by number of CTS edges seen
+  pthread_t thread;
+  volatile bool active; // Cleared if serial driver can't wait on pin changes, caller should poll instead.
+} cts_watcher_t;
+
+extern serial_line_t g_serial_line; // Current line format, kept up to date on reconfiguring the port
 
 int serial_write(int fd, uint8_t *buffer, int size);
 
 int serial_write_terminal(int fd, uint8_t *buffer, int size);
 
-bool serial_waitfor_tx(uint32_t max_wait_us);
+int serial_outq(int fd);
+
+bool serial_waitfor_tx(int fd, uint32_t max_wait_us);
 
 int serial_read(int fd, uint8_t *buffer, int size);
 
@@ -33,16 +49,30 @@ int enable_pin(int fd, int flag);
 
 int disable_pin(int fd, int flag);
 
-int setup_tty(int fd, speed_t baudrate);
+int setup_tty(int fd, uint32_t baud, int data_bits);
+
+void serial_set_data_bits(int fd, int data_bits);
+
+void serial_set_baud(int fd, uint32_t baud);
 
 void wait_pin_state(int fd, int flag, int desired_state);
 
 void mouse_ident(int fd, bool wheel);
 
+bool cts_watcher_start(cts_watcher_t *watcher, int fd);
+
+uint64_t cts_watcher_edges(cts_watcher_t *watcher);
+
 void timespec_diff(struct timespec *ts1, struct timespec *ts2, struct timespec *result);
 
 bool timespec_reached(struct timespec *target);
 
+uint64_t timespec_to_ns(struct timespec *ts);
+
+struct timespec ns_to_timespec(uint64_t ns);
+
+uint64_t get_time_ns();
+
 struct timespec get_target_time(uint8_t seconds, uint32_t nseconds);
 
 #endif // SERIAL_H_
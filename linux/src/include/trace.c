@@ -0,0 +1,180 @@
+/*
+ * Anachro Mouse, a usb to serial mouse adaptor. Copyright (C) 2025 Aviancer <oss+amouse@skyvian.me>
+ *
+ * This library is free software; you can redistribute it and/or modify it under the terms of the 
+ * GNU Lesser General Public License as published by the Free Software Foundation; either version 
+ * 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without 
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the 
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with this library; 
+ * if not, write to the Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*/
+
+/* trace.c: capture of input frames and serial packets, for offline replay */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "trace.h"
+#include "../../../shared/settings.h"
+
+// On-disk layout, must not change without a version bump.
+_Static_assert(sizeof(trace_header_t) == 64, "trace header size");
+_Static_assert(sizeof(trace_record_t) == 32, "trace record size");
+
+static void trace_write(FILE *trace, trace_record_t const *record) {
+  if(fwrite(record, sizeof(trace_record_t), 1, trace) != 1) {
+    fprintf(stderr, "Trace write failed: %d: %s\n", errno, strerror(errno));
+  }
+}
+
+FILE* trace_create(const char *path, mouse_opts_t *options) {
+  uint8_t binary_settings[SETTINGS_SIZE] = {0};
+  trace_header_t header = {0};
+  FILE *trace;
+
+  if((trace = fopen(path, "wb")) == NULL) { return NULL; }
+
+  settings_encode(&binary_settings[0], options);
+  memcpy(header.magic, TRACE_MAGIC, sizeof(header.magic));
+  header.version = TRACE_VERSION;
+  header.record_size = sizeof(trace_record_t);
+  memcpy(header.settings, binary_settings, sizeof(header.settings));
+  header.sensitivity = options->sensitivity;
+  header.accel_points_num = options->accel_points_num;
+  for(int i=0; i < ACCEL_POINTS_MAX; i++) {
+    header.accel_speed[i] = options->accel_points[i].speed;
+    header.accel_gain[i] = options->accel_points[i].gain;
+  }
+
+  if(fwrite(&header, sizeof(header), 1, trace) != 1) {
+    fclose(trace);
+    return NULL;
+  }
+  return trace;
+}
+
+void trace_write_frame(FILE *trace, uint64_t time_ns, mouse_frame_t const *frame) {
+  trace_record_t record = { .time_ns = time_ns, .type = TRACE_FRAME };
+
+  record.lmb = frame->lmb;
+  record.rmb = frame->rmb;
+  record.mmb = frame->mmb;
+  record.motion.x = frame->x;
+  record.motion.y = frame->y;
+  record.motion.wheel = frame->wheel;
+  trace_write(trace, &record);
+}
+
+void trace_write_packet(FILE *trace, uint64_t time_ns, uint8_t const *packet, int len) {
+  trace_record_t record = { .time_ns = time_ns, .type = TRACE_PACKET };
+
+  record.len = (len > (int)sizeof(record.packet)) ? sizeof(record.packet) : len;
+  memcpy(record.packet, packet, record.len);
+  trace_write(trace, &record);
+}
+
+void trace_write_ident(FILE *trace, uint64_t time_ns) {
+  trace_record_t record = { .time_ns = time_ns, .type = TRACE_IDENT };
+  trace_write(trace, &record);
+}
+
+void trace_write_line(FILE *trace, uint64_t time_ns, mouse_state_t const *mouse) {
+  trace_record_t record = { .time_ns = time_ns, .type = TRACE_LINE };
+
+  record.line.baud = mouse->baud;
+  record.line.report_rate = mouse->report_rate;
+  trace_write(trace, &record);
+}
+
+void trace_write_settings(FILE *trace, uint64_t time_ns, mouse_opts_t *options) {
+  uint8_t binary_settings[SETTINGS_SIZE] = {0};
+  trace_record_t record = { .time_ns = time_ns, .type = TRACE_SETTINGS };
+
+  settings_encode(&binary_settings[0], options);
+  memcpy(record.settings, binary_settings, sizeof(record.settings));
+  record.sensitivity = options->sensitivity;
+  trace_write(trace, &record);
+}
+
+// Map trace file into memory, checks header and trims any partially written record at the end.
+bool trace_map(const char *path, trace_map_t *map) {
+  struct stat st;
+  int fd;
+
+  memset(map, 0, sizeof(trace_map_t));
+  if((fd = open(path, O_RDONLY)) < 0) { return false; }
+  if(fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(trace_header_t)) {
+    close(fd);
+    errno = EINVAL;
+    return false;
+  }
+
+  map->size = st.st_size;
+  map->base = mmap(NULL, map->size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if(map->base == MAP_FAILED) {
+    map->base = NULL;
+    return false;
+  }
+
+  map->header = (trace_header_t const*)map->base;
+  if(memcmp(map->header->magic, TRACE_MAGIC, sizeof(map->header->magic)) != 0 || 
+     map->header->version != TRACE_VERSION || map->header->record_size != sizeof(trace_record_t)) {
+    trace_unmap(map);
+    errno = EINVAL;
+    return false;
+  }
+
+  map->records = (trace_record_t const*)((uint8_t const*)map->base + sizeof(trace_header_t));
+  map->count = (map->size - sizeof(trace_header_t)) / sizeof(trace_record_t);
+  return true;
+}
+
+void trace_unmap(trace_map_t *map) {
+  if(map->base) { munmap(map->base, map->size); }
+  memset(map, 0, sizeof(trace_map_t));
+}
+
+void trace_frame(trace_record_t const *record, mouse_frame_t *frame) {
+  frame->x = record->motion.x;
+  frame->y = record->motion.y;
+  frame->wheel = record->motion.wheel;
+  frame->lmb = record->lmb;
+  frame->rmb = record->rmb;
+  frame->mmb = record->mmb;
+}
+
+// Settings bytes plus the exact sensitivity, which settings only keep in 0.2 steps.
+static bool trace_decode_settings(uint8_t const *settings, uint16_t sensitivity, mouse_opts_t *options) {
+  uint8_t binary_settings[SETTINGS_SIZE] = {0};
+
+  memcpy(binary_settings, settings, 8);
+  if(!settings_decode(&binary_settings[0], options)) { return false; }
+  if(sensitivity > 0) { options->sensitivity = sensitivity; }
+  return true;
+}
+
+// Mouse options the trace was captured with.
+bool trace_options(trace_header_t const *header, mouse_opts_t *options) {
+  if(!trace_decode_settings(header->settings, header->sensitivity, options)) { return false; }
+
+  options->accel_points_num = (header->accel_points_num > ACCEL_POINTS_MAX) ? ACCEL_POINTS_MAX : header->accel_points_num;
+  for(int i=0; i < ACCEL_POINTS_MAX; i++) {
+    options->accel_points[i].speed = header->accel_speed[i];
+    options->accel_points[i].gain = header->accel_gain[i];
+  }
+  return true;
+}
+
+// Mouse options from a settings record, custom acceleration points are left as they are.
+bool trace_record_options(trace_record_t const *record, mouse_opts_t *options) {
+  return trace_decode_settings(record->settings, record->sensitivity, options);
+}
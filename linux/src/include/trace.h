@@ -0,0 +1,110 @@
+/*
+ * Anachro Mouse, a usb to serial mouse adaptor. Copyright (C) 2025 Aviancer <oss+amouse@skyvian.me>
+ *
+ * This library is free software; you can redistribute it and/or modify it under the terms of the 
+ * GNU Lesser General Public License as published by the Free Software Foundation; either version 
+ * 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without 
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the 
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with this library; 
+ * if not, write to the Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*/
+
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "input.h"
+#include "../../../shared/mouse_defs.h"
+
+#define TRACE_MAGIC   "AMTR"
+#define TRACE_VERSION 0x01
+
+/*
+ *  Trace file layout (Version 0x01), host byte order:
+ *    [header 64 bytes][record 32 bytes]...
+ *
+ *  Fixed size records so a trace can be mapped into memory and walked as an array.
+ *  Frames carry the input fed into process_mouse_report(), packets the bytes written 
+ *  out to serial line. Times are CLOCK_MONOTONIC nanoseconds, frames use the kernel 
+ *  event timestamp.
+*/
+
+enum TRACE_RECORDS {
+  TRACE_FRAME    = 0x01, // Input frame at SYN_REPORT
+  TRACE_PACKET   = 0x02, // Serial packet written out
+  TRACE_IDENT    = 0x03, // Driver initialized mouse
+  TRACE_LINE     = 0x04, // Baud or report rate changed by driver
+  TRACE_SETTINGS = 0x05  // Settings changed from console
+};
+
+typedef struct trace_header {
+  char     magic[4];
+  uint16_t version;
+  uint16_t record_size;
+  uint8_t  settings[8];     // Mouse options at start of capture, settings_encode() format
+  uint8_t  accel_points_num; // Custom acceleration points are not part of settings
+  uint8_t  reserved1;
+  uint16_t sensitivity;      // Q8.8 as given, settings round it to 0.2 steps. 0 in older traces
+  uint8_t  reserved2[4];
+  uint8_t  accel_speed[ACCEL_POINTS_MAX];
+  uint16_t accel_gain[ACCEL_POINTS_MAX];
+  uint8_t  reserved3[16];
+} trace_header_t;
+
+typedef struct trace_record {
+  uint64_t time_ns;
+  uint8_t  type;
+  uint8_t  len;           // Packet length
+  int8_t   lmb, rmb, mmb; // Frame button state, -1 when unchanged
+  uint8_t  reserved;
+  uint16_t sensitivity;   // Settings: Q8.8 sensitivity, as in header
+  union {
+    struct { int32_t x, y, wheel; } motion;
+    struct { uint32_t baud, report_rate; } line;
+    uint8_t packet[16];
+    uint8_t settings[8];
+  };
+} trace_record_t;
+
+// Read only mapping of a trace file.
+typedef struct trace_map {
+  void *base;
+  size_t size;
+  trace_header_t const *header;
+  trace_record_t const *records;
+  size_t count;
+} trace_map_t;
+
+/* Functions */
+
+FILE* trace_create(const char *path, mouse_opts_t *options);
+
+void trace_write_frame(FILE *trace, uint64_t time_ns, mouse_frame_t const *frame);
+
+void trace_write_packet(FILE *trace, uint64_t time_ns, uint8_t const *packet, int len);
+
+void trace_write_ident(FILE *trace, uint64_t time_ns);
+
+void trace_write_line(FILE *trace, uint64_t time_ns, mouse_state_t const *mouse);
+
+void trace_write_settings(FILE *trace, uint64_t time_ns, mouse_opts_t *options);
+
+bool trace_map(const char *path, trace_map_t *map);
+
+void trace_unmap(trace_map_t *map);
+
+void trace_frame(trace_record_t const *record, mouse_frame_t *frame);
+
+bool trace_options(trace_header_t const *header, mouse_opts_t *options);
+
+bool trace_record_options(trace_record_t const *record, mouse_opts_t *options);
+
+#endif // TRACE_H_
@@ -0,0 +1,106 @@
+/*
+ * Anachro Mouse, a usb to serial mouse adaptor. Copyright (C) 2025 Aviancer <oss+amouse@skyvian.me>
+ *
+ * This library is free software; you can redistribute it and/or modify it under the terms of the 
+ * GNU Lesser General Public License as published by the Free Software Foundation; either version 
+ * 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without 
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the 
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with this library; 
+ * if not, write to the Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*/
+
+/* decoder.c: serial mouse packets back into motion and buttons, for testing amouse from the host side */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "decoder.h"
+
+// First byte of a packet: bit 6 set in Microsoft protocols, 10000LMR in Mouse Systems.
+static bool is_sync(int protocol, uint8_t byte) {
+  if(protocol == PROTO_MOUSESYS) { return((byte & 0xf8) == 0x80); }
+  return(byte & 0x40);
+}
+
+static int packet_max(int protocol) {
+  switch(protocol) {
+    case PROTO_MS2BUTTON: return(3);
+    case PROTO_MOUSESYS:  return(5);
+    default:              return(4); // Logitech and MS wheel, 4th byte is optional
+  }
+}
+
+static void decode(packet_decoder_t *decoder, decoded_packet_t *packet) {
+  uint8_t *b = decoder->buffer;
+
+  memset(packet, 0, sizeof(decoded_packet_t));
+  packet->time_ns = decoder->time_ns;
+  packet->len = decoder->len;
+
+  if(decoder->protocol == PROTO_MOUSESYS) {
+    packet->lmb = !(b[0] & 0x04);
+    packet->mmb = !(b[0] & 0x02);
+    packet->rmb = !(b[0] & 0x01);
+    packet->x   = (int8_t)b[1] + (int8_t)b[3];
+    packet->y   = -((int8_t)b[2] + (int8_t)b[4]);
+    return;
+  }
+
+  packet->lmb = b[0] & (1 << MOUSE_LMB_BIT);
+  packet->rmb = b[0] & (1 << MOUSE_RMB_BIT);
+  packet->x   = (int8_t)(((b[0] & 0x03) << 6) | (b[1] & 0x3f));
+  packet->y   = (int8_t)(((b[0] & 0x0c) << 4) | (b[2] & 0x3f));
+
+  // Without the 4th byte MMB is up and wheel idle
+  if(decoder->len < 4) { return; }
+  if(decoder->protocol == PROTO_LOGITECH) {
+    packet->mmb = b[3] & 0x20;
+  }
+  else {
+    packet->mmb = b[3] & (1 << MOUSE_MMB_BIT);
+    packet->wheel = -(((b[3] & 0x0f) ^ 0x08) - 0x08); // 4 bit two's complement
+  }
+}
+
+void decoder_init(packet_decoder_t *decoder, int protocol) {
+  memset(decoder, 0, sizeof(packet_decoder_t));
+  decoder->protocol = protocol;
+}
+
+// Returns true with the previous packet when it is known to be complete. Optional 4th bytes mean 
+// a 3 byte packet is only complete once the next sync byte arrives.
+bool decoder_feed(packet_decoder_t *decoder, uint8_t byte, uint64_t time_ns, decoded_packet_t *packet) {
+  bool complete = false;
+
+  if(is_sync(decoder->protocol, byte) && (decoder->protocol != PROTO_MOUSESYS || decoder->len == 0)) {
+    complete = decoder_flush(decoder, packet);
+    decoder->buffer[0] = byte;
+    decoder->len = 1;
+    decoder->time_ns = time_ns;
+    return(complete);
+  }
+
+  if(decoder->len == 0) {
+    decoder->sync_errors++;
+    return(false);
+  }
+
+  decoder->buffer[decoder->len++] = byte;
+  if(decoder->len == packet_max(decoder->protocol)) { complete = decoder_flush(decoder, packet); }
+  return(complete);
+}
+
+// Hand out a pending packet, if it has at least the mandatory bytes.
+bool decoder_flush(packet_decoder_t *decoder, decoded_packet_t *packet) {
+  int min = (decoder->protocol == PROTO_MOUSESYS) ? 5 : 3;
+  bool complete = (decoder->len >= min);
+
+  if(complete) { decode(decoder, packet); }
+  else if(decoder->len > 0) { decoder->sync_errors += decoder->len; }
+  decoder->len = 0;
+  return(complete);
+}
@@ -0,0 +1,49 @@
+/*
+ * Anachro Mouse, a usb to serial mouse adaptor. Copyright (C) 2025 Aviancer <oss+amouse@skyvian.me>
+ *
+ * This library is free software; you can redistribute it and/or modify it under the terms of the 
+ * GNU Lesser General Public License as published by the Free Software Foundation; either version 
+ * 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without 
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the 
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with this library; 
+ * if not, write to the Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*/
+
+#ifndef DECODER_H_
+#define DECODER_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "../../shared/mouse_defs.h"
+
+// Packet as the host mouse driver would see it.
+typedef struct decoded_packet {
+  uint64_t time_ns; // Arrival of first byte
+  int len;
+  int x, y, wheel;  // In evdev directions, Y grows downwards and wheel is positive scrolling up
+  bool lmb, rmb, mmb;
+} decoded_packet_t;
+
+// Byte stream parser, packets are framed by the sync byte of the selected protocol.
+typedef struct packet_decoder {
+  int protocol;
+  uint8_t buffer[MOUSE_PACKET_MAX];
+  int len;
+  uint64_t time_ns;
+  int sync_errors; // Bytes dropped while out of sync
+} packet_decoder_t;
+
+/* Functions */
+
+void decoder_init(packet_decoder_t *decoder, int protocol);
+
+bool decoder_feed(packet_decoder_t *decoder, uint8_t byte, uint64_t time_ns, decoded_packet_t *packet);
+
+bool decoder_flush(packet_decoder_t *decoder, decoded_packet_t *packet);
+
+#endif // DECODER_H_
@@ -0,0 +1,359 @@
+/*
+ * Anachro Mouse, a usb to serial mouse adaptor. Copyright (C) 2025 Aviancer <oss+amouse@skyvian.me>
+ *
+ * This library is free software; you can redistribute it and/or modify it under the terms of the 
+ * GNU Lesser General Public License as published by the Free Software Foundation; either version 
+ * 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without 
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the 
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with this library; 
+ * if not, write to the Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*/
+
+/* e2e.c: end-to-end harness, runs amouse against a pseudo-terminal with a virtual uinput mouse.
+ *
+ * The other end of the pty decodes the serial mouse protocol like a host driver would, so packet
+ * rate, pacing against the serial line budget and motion fidelity can be checked without serial 
+ * hardware. Needs access to /dev/uinput.
+*/
+
+#define _GNU_SOURCE // ppoll, ptsname
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <termios.h>
+#include <sys/wait.h>
+#include <linux/input.h>
+
+#include "decoder.h"
+#include "uinput.h"
+#include "../../shared/mouse.h"
+#include "../../shared/pacing.h"
+#include "../../shared/utils.h"
+
+#define MS_IDENT_TIMEOUT 5000
+#define MS_SETTLE_IDLE   500  // Output has stopped once the line is quiet this long
+#define MS_SETTLE_MAX    5000
+#define ARGS_MAX         32
+
+struct harness_opts {
+  char *amouse;
+  int protocol;
+  int rate;        // Input events per second
+  int dx, dy;      // Motion per event
+  int seconds;
+  int click_ms;    // LMB toggle period, 0 for none
+  int wheel_ms;    // Wheel click period, 0 for none
+  int verbose;
+  char **extra;    // Passed on to amouse
+  int extra_num;
+};
+
+typedef struct harness_stats {
+  // Sent through uinput
+  uint64_t events;
+  int64_t sent_x, sent_y, sent_wheel;
+  int sent_clicks;
+  // Decoded from serial line
+  uint64_t packets, bytes;
+  int64_t got_x, got_y, got_wheel;
+  int got_clicks;
+  bool lmb;
+  uint64_t first_ns, last_ns;
+  uint64_t interval_min, interval_sum;
+  uint64_t early;  // Packets starting before the previous one could have left the line
+  uint64_t prev_ns;
+  uint64_t prev_airtime;
+} harness_stats_t;
+
+static uint64_t now_ns() {
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return (uint64_t)time.tv_sec * NS_FULL_SECOND + time.tv_nsec;
+}
+
+static void showhelp(char *argv[]) {
+  printf("Usage: %s [options] [-- amouse options]\n\n" \
+    "  -a <File> amouse binary to test (default: bin/amouse)\n" \
+    "  -p <Proto num> Serial protocol\n" \
+    "  -f <Hz> Input event rate (default: 1000)\n" \
+    "  -x <Counts> X motion per event (default: 2)\n" \
+    "  -y <Counts> Y motion per event (default: 1)\n" \
+    "  -t <Seconds> Test duration (default: 5)\n" \
+    "  -b <ms> Toggle left button every ms\n" \
+    "  -w <ms> Scroll wheel every ms\n" \
+    "  -v Show amouse output\n", argv[0]);
+}
+
+static void parse_opts(int argc, char **argv, struct harness_opts *options) {
+  int option_index;
+
+  options->amouse = "bin/amouse";
+  options->protocol = PROTO_MSWHEEL;
+  options->rate = 1000;
+  options->dx = 2;
+  options->dy = 1;
+  options->seconds = 5;
+
+  while((option_index = getopt(argc, argv, "ha:p:f:x:y:t:b:w:v")) != -1) {
+    switch(option_index) {
+      case 'a': options->amouse = optarg; break;
+      case 'p': options->protocol = clampi(atoi(optarg), 0, g_mouse_protocol_num - 1); break;
+      case 'f': options->rate = clampi(atoi(optarg), 1, 16000); break;
+      case 'x': options->dx = atoi(optarg); break;
+      case 'y': options->dy = atoi(optarg); break;
+      case 't': options->seconds = clampi(atoi(optarg), 1, 3600); break;
+      case 'b': options->click_ms = clampi(atoi(optarg), 0, 60000); break;
+      case 'w': options->wheel_ms = clampi(atoi(optarg), 0, 60000); break;
+      case 'v': options->verbose = 1; break;
+      default:
+        showhelp(argv); exit(0);
+    }
+  }
+  options->extra = &argv[optind];
+  options->extra_num = argc - optind;
+}
+
+// Pty pair, amouse gets the slave end. Slave stays open here too so the master doesn't see a hangup 
+// before amouse has opened it.
+static int open_pty(char *slave_path, size_t path_len, int *slave_fd) {
+  int master = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+  if(master < 0 || grantpt(master) < 0 || unlockpt(master) < 0) { return -1; }
+  strncpy(slave_path, ptsname(master), path_len - 1);
+
+  *slave_fd = open(slave_path, O_RDWR | O_NOCTTY);
+  if(*slave_fd < 0) { return -1; }
+
+  struct termios tty;
+  tcgetattr(master, &tty);
+  cfmakeraw(&tty);
+  tcsetattr(master, TCSANOW, &tty);
+  return master;
+}
+
+static pid_t start_amouse(struct harness_opts *options, const char *mouse_path, const char *serial_path) {
+  char *args[ARGS_MAX];
+  char proto[4];
+  int n = 0;
+
+  snprintf(proto, sizeof(proto), "%d", options->protocol);
+  args[n++] = options->amouse;
+  args[n++] = "-i";
+  args[n++] = "-m"; args[n++] = (char*)mouse_path;
+  args[n++] = "-s"; args[n++] = (char*)serial_path;
+  args[n++] = "-p"; args[n++] = proto;
+  args[n++] = "-r"; args[n++] = "10"; // 1.0 sensitivity, motion should arrive as sent
+  for(int i=0; i < options->extra_num && n < ARGS_MAX - 1; i++) { args[n++] = options->extra[i]; }
+  args[n] = NULL;
+
+  pid_t pid = fork();
+  if(pid == 0) {
+    if(!options->verbose) {
+      int null_fd = open("/dev/null", O_WRONLY);
+      dup2(null_fd, STDOUT_FILENO);
+      dup2(null_fd, STDERR_FILENO);
+    }
+    execv(options->amouse, args);
+    fprintf(stderr, "execv(%s) failed: %d: %s\n", options->amouse, errno, strerror(errno));
+    _exit(127);
+  }
+  return pid;
+}
+
+// Read up to len bytes, waiting at most timeout_ms in total.
+static int read_timeout(int fd, uint8_t *buffer, int len, int timeout_ms) {
+  uint64_t deadline = now_ns() + (uint64_t)timeout_ms * 1000000;
+  struct pollfd pfd = { .fd = fd, .events = POLLIN };
+  int got = 0;
+
+  while(got < len && now_ns() < deadline) {
+    if(poll(&pfd, 1, (deadline - now_ns()) / 1000000 + 1) <= 0) { continue; }
+    int n = read(fd, buffer + got, len - got);
+    if(n > 0) { got += n; }
+  }
+  return got;
+}
+
+static bool check_ident(int master, int protocol) {
+  uint8_t expected[128];
+  uint8_t received[128];
+  int len;
+
+  if(protocol == PROTO_MSWHEEL) {
+    len = g_pkt_intellimouse_intro_len;
+    memcpy(expected, g_pkt_intellimouse_intro, len);
+  }
+  else {
+    len = g_mouse_protocol[protocol].serial_ident_len;
+    memcpy(expected, g_mouse_protocol[protocol].serial_ident, len);
+  }
+  if(len == 0) { return true; } // Mouse Systems has no ident
+
+  int got = read_timeout(master, received, len, MS_IDENT_TIMEOUT);
+  if(got != len || memcmp(expected, received, len) != 0) {
+    fprintf(stderr, "Ident mismatch, got %d of %d bytes.\n", got, len);
+    return false;
+  }
+  return true;
+}
+
+static void account_packet(harness_stats_t *stats, decoded_packet_t *packet, serial_line_t *line) {
+  if(stats->packets == 0) { stats->first_ns = packet->time_ns; }
+  else {
+    uint64_t interval = packet->time_ns - stats->prev_ns;
+    if(interval < stats->interval_min || stats->packets == 1) { stats->interval_min = interval; }
+    stats->interval_sum += interval;
+    if(interval < stats->prev_airtime) { stats->early++; }
+  }
+  stats->prev_ns = stats->last_ns = packet->time_ns;
+  stats->prev_airtime = line_time(line, packet->len);
+
+  stats->packets++;
+  stats->bytes += packet->len;
+  stats->got_x += packet->x;
+  stats->got_y += packet->y;
+  stats->got_wheel += packet->wheel;
+  if(packet->lmb && !stats->lmb) { stats->got_clicks++; }
+  stats->lmb = packet->lmb;
+}
+
+static void read_packets(int master, packet_decoder_t *decoder, harness_stats_t *stats, serial_line_t *line) {
+  uint8_t buffer[256];
+  decoded_packet_t packet;
+  int len;
+
+  while((len = read(master, buffer, sizeof(buffer))) > 0) {
+    uint64_t now = now_ns();
+    for(int i=0; i < len; i++) {
+      if(decoder_feed(decoder, buffer[i], now, &packet)) { account_packet(stats, &packet, line); }
+    }
+  }
+}
+
+static void emit_input(int mouse, struct harness_opts *options, harness_stats_t *stats, uint64_t elapsed_ns) {
+  static uint64_t next_click, next_wheel;
+  static int lmb;
+
+  uinput_emit(mouse, EV_REL, REL_X, options->dx);
+  uinput_emit(mouse, EV_REL, REL_Y, options->dy);
+  stats->sent_x += options->dx;
+  stats->sent_y += options->dy;
+
+  if(options->click_ms && elapsed_ns >= next_click) {
+    lmb = !lmb;
+    uinput_emit(mouse, EV_KEY, BTN_LEFT, lmb);
+    if(lmb) { stats->sent_clicks++; }
+    next_click += (uint64_t)options->click_ms * 1000000;
+  }
+  if(options->wheel_ms && elapsed_ns >= next_wheel) {
+    uinput_emit(mouse, EV_REL, REL_WHEEL, 1);
+    stats->sent_wheel++;
+    next_wheel += (uint64_t)options->wheel_ms * 1000000;
+  }
+  uinput_emit(mouse, EV_SYN, SYN_REPORT, 0);
+  stats->events++;
+}
+
+static int report(struct harness_opts *options, harness_stats_t *stats, packet_decoder_t *decoder, serial_line_t *line) {
+  double active = (stats->last_ns > stats->first_ns) ? (stats->last_ns - stats->first_ns) / 1e9 : 1.0;
+  double capacity = (double)line->baud / line->frame_bits;
+  bool wheel = g_mouse_protocol[options->protocol].wheel;
+  bool lost = (stats->sent_x != stats->got_x || stats->sent_y != stats->got_y || stats->sent_clicks != stats->got_clicks || 
+              (wheel && stats->sent_wheel != stats->got_wheel));
+
+  printf("%s, %d Hz input for %d s\n", g_mouse_protocol[options->protocol].name, options->rate, options->seconds);
+  printf("  Input:   %llu events\n", (unsigned long long)stats->events);
+  printf("  Packets: %llu, %.1f/s\n", (unsigned long long)stats->packets, stats->packets / active);
+  printf("  Bytes:   %.1f/s of %.1f/s line capacity\n", stats->bytes / active, capacity);
+  if(stats->packets > 1) {
+    printf("  Packet interval: min %.2f ms, mean %.2f ms, %llu started before previous packet airtime\n", 
+      stats->interval_min / 1e6, stats->interval_sum / 1e6 / (stats->packets - 1), (unsigned long long)stats->early);
+  }
+  printf("  Motion:  x %lld/%lld, y %lld/%lld (decoded/sent)\n", (long long)stats->got_x, (long long)stats->sent_x, 
+    (long long)stats->got_y, (long long)stats->sent_y);
+  printf("  Clicks:  %d/%d", stats->got_clicks, stats->sent_clicks);
+  if(wheel) { printf(", wheel %lld/%lld", (long long)stats->got_wheel, (long long)stats->sent_wheel); }
+  printf("\n  Sync errors: %d\n", decoder->sync_errors);
+
+  return (lost || decoder->sync_errors) ? 1 : 0;
+}
+
+int main(int argc, char **argv) {
+  struct harness_opts options = {0};
+  harness_stats_t stats = {0};
+  packet_decoder_t decoder;
+  decoded_packet_t packet;
+  serial_line_t line;
+  char mouse_path[64], serial_path[64] = {0};
+  int slave;
+
+  parse_opts(argc, argv, &options);
+
+  int master = open_pty(serial_path, sizeof(serial_path), &slave);
+  if(master < 0) {
+    fprintf(stderr, "Pseudo-terminal open failed: %d: %s\n", errno, strerror(errno));
+    exit(-1);
+  }
+  int mouse = uinput_mouse_create("amouse e2e mouse", mouse_path, sizeof(mouse_path));
+  if(mouse < 0) {
+    fprintf(stderr, "uinput mouse create failed: %d: %s\n", errno, strerror(errno));
+    exit(-1);
+  }
+
+  pid_t pid = start_amouse(&options, mouse_path, serial_path);
+  if(pid < 0 || !check_ident(master, options.protocol)) {
+    if(pid > 0) { kill(pid, SIGTERM); waitpid(pid, NULL, 0); }
+    uinput_mouse_destroy(mouse);
+    exit(-1);
+  }
+
+  decoder_init(&decoder, options.protocol);
+  line_init(&line, NS_FULL_SECOND, MOUSE_BAUD_DEFAULT, g_mouse_protocol[options.protocol].data_bits, 0, 1);
+
+  /*** Drive input and decode output ***/
+  struct pollfd pfd = { .fd = master, .events = POLLIN };
+  uint64_t period = NS_FULL_SECOND / options.rate;
+  uint64_t start = now_ns();
+  uint64_t end = start + (uint64_t)options.seconds * NS_FULL_SECOND;
+  uint64_t next = start;
+  uint64_t now;
+
+  while((now = now_ns()) < end) {
+    if(now >= next) {
+      emit_input(mouse, &options, &stats, now - start);
+      next += period;
+      continue;
+    }
+    struct timespec timeout = { .tv_sec = (next - now) / NS_FULL_SECOND, .tv_nsec = (next - now) % NS_FULL_SECOND };
+    if(ppoll(&pfd, 1, &timeout, NULL) > 0) { read_packets(master, &decoder, &stats, &line); }
+  }
+
+  // Release button, then let aggregated and carried motion drain out
+  if(options.click_ms && (stats.sent_clicks > 0)) {
+    uinput_emit(mouse, EV_KEY, BTN_LEFT, 0);
+    uinput_emit(mouse, EV_SYN, SYN_REPORT, 0);
+  }
+  uint64_t settle_end = now_ns() + (uint64_t)MS_SETTLE_MAX * 1000000;
+  while(now_ns() < settle_end && poll(&pfd, 1, MS_SETTLE_IDLE) > 0) {
+    read_packets(master, &decoder, &stats, &line);
+  }
+  if(decoder_flush(&decoder, &packet)) { account_packet(&stats, &packet, &line); }
+
+  kill(pid, SIGTERM);
+  waitpid(pid, NULL, 0);
+  uinput_mouse_destroy(mouse);
+  close(slave);
+  close(master);
+
+  return report(&options, &stats, &decoder, &line);
+}
@@ -0,0 +1,232 @@
+/*
+ * Anachro Mouse, a usb to serial mouse adaptor. Copyright (C) 2025 Aviancer <oss+amouse@skyvian.me>
+ *
+ * This library is free software; you can redistribute it and/or modify it under the terms of the
+ * GNU Lesser General Public License as published by the Free Software Foundation; either version
+ * 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with this library;
+ * if not, write to the Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*/
+
+/* mousegen.c: virtual uinput mouse playing back synthetic patterns, for load testing amouse.
+ *
+ * Creates the device, prints its /dev/input/event* path for amouse -m and after a start delay
+ * emits frames at the selected rate until the duration is up or it is interrupted.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <getopt.h>
+#include <linux/input.h>
+
+#include "uinput.h"
+
+#define NS_FULL_SECOND   1000000000ULL
+#define FRAME_EVENTS_MAX 7 // X, Y, wheel, 3 buttons and SYN_REPORT
+
+enum PATTERNS {
+  PATTERN_MOVE    = 0, // Constant motion
+  PATTERN_ZIGZAG  = 1, // Direction reverses every 250ms
+  PATTERN_JITTER  = 2, // +-1 sensor noise, high DPI mouse held still
+  PATTERN_FLICK   = 3, // 100ms fast flick every second
+  PATTERN_BUTTONS = 4, // Button storm, button changes on every frame
+  PATTERN_WHEEL   = 5, // Bursts of wheel clicks while moving
+  PATTERN_NUM
+};
+
+static const char *pattern_names[PATTERN_NUM] = { "move", "zigzag", "jitter", "flick", "buttons", "wheel" };
+
+struct gen_opts {
+  int pattern;
+  int rate;    // Frames per second
+  int dx, dy;  // Motion magnitude per frame
+  int seconds; // 0 runs until interrupted
+  int delay;   // Seconds to wait before starting, to start amouse on the device
+};
+
+typedef struct gen_frame {
+  int x, y, wheel;
+  int lmb, rmb, mmb; // -1 when unchanged
+} gen_frame_t;
+
+static volatile sig_atomic_t quit_requested = 0;
+
+static void handle_signal(int signum) {
+  quit_requested = 1;
+}
+
+static void showhelp(char *argv[]) {
+  printf("Usage: %s [options]\n\n" \
+    "  -P <Pattern> move, zigzag, jitter, flick, buttons or wheel (default: move)\n" \
+    "  -f <125-8000> Frame rate in Hz (default: 1000)\n" \
+    "  -x <Counts> X motion per frame (default: 2)\n" \
+    "  -y <Counts> Y motion per frame (default: 1)\n" \
+    "  -t <Seconds> Run time, 0 until interrupted (default: 10)\n" \
+    "  -d <Seconds> Delay before starting (default: 3)\n", argv[0]);
+}
+
+static void parse_opts(int argc, char **argv, struct gen_opts *options) {
+  int option_index;
+
+  options->pattern = PATTERN_MOVE;
+  options->rate = 1000;
+  options->dx = 2;
+  options->dy = 1;
+  options->seconds = 10;
+  options->delay = 3;
+
+  while((option_index = getopt(argc, argv, "hP:f:x:y:t:d:")) != -1) {
+    switch(option_index) {
+      case 'P':
+        options->pattern = -1;
+        for(int i=0; i < PATTERN_NUM; i++) {
+          if(strcmp(optarg, pattern_names[i]) == 0) { options->pattern = i; }
+        }
+        if(options->pattern < 0) { showhelp(argv); exit(1); }
+        break;
+      case 'f':
+        options->rate = atoi(optarg);
+        if(options->rate < 125) { options->rate = 125; }
+        if(options->rate > 8000) { options->rate = 8000; }
+        break;
+      case 'x': options->dx = atoi(optarg); break;
+      case 'y': options->dy = atoi(optarg); break;
+      case 't': options->seconds = (atoi(optarg) > 0) ? atoi(optarg) : 0; break;
+      case 'd': options->delay = (atoi(optarg) > 0) ? atoi(optarg) : 0; break;
+      default:
+        showhelp(argv); exit(0);
+    }
+  }
+}
+
+// Fill in frame n of the pattern, time based patterns keep their timing at any frame rate.
+static void pattern_frame(struct gen_opts *options, uint64_t n, gen_frame_t *frame) {
+  uint64_t ms = n * 1000 / options->rate;
+
+  frame->x = frame->y = frame->wheel = 0;
+  frame->lmb = frame->rmb = frame->mmb = -1;
+
+  switch(options->pattern) {
+    case PATTERN_MOVE:
+      frame->x = options->dx;
+      frame->y = options->dy;
+      break;
+    case PATTERN_ZIGZAG:
+      frame->x = ((ms / 250) % 2) ? -options->dx : options->dx;
+      frame->y = options->dy;
+      break;
+    case PATTERN_JITTER:
+      frame->x = (rand() % 3) - 1;
+      frame->y = (rand() % 3) - 1;
+      break;
+    case PATTERN_FLICK:
+      if(ms % 1000 < 100) {
+        frame->x = ((ms / 1000) % 2) ? -20 * options->dx : 20 * options->dx;
+        frame->y = -4 * options->dy;
+      }
+      break;
+    case PATTERN_BUTTONS:
+      frame->lmb = n % 2;
+      if(n % 3 == 0) { frame->rmb = (n / 3) % 2; }
+      if(n % 5 == 0) { frame->mmb = (n / 5) % 2; }
+      frame->x = options->dx;
+      break;
+    case PATTERN_WHEEL:
+      frame->x = options->dx;
+      frame->y = options->dy;
+      if(ms % 500 < 50) { frame->wheel = ((ms / 500) % 2) ? -1 : 1; }
+      break;
+  }
+}
+
+// Returns number of events in frame, 0 if there is nothing to report.
+static int frame_events(gen_frame_t *frame, struct input_event *events) {
+  int n = 0;
+
+  memset(events, 0, FRAME_EVENTS_MAX * sizeof(struct input_event));
+  if(frame->lmb >= 0) { events[n].type = EV_KEY; events[n].code = BTN_LEFT;   events[n++].value = frame->lmb; }
+  if(frame->rmb >= 0) { events[n].type = EV_KEY; events[n].code = BTN_RIGHT;  events[n++].value = frame->rmb; }
+  if(frame->mmb >= 0) { events[n].type = EV_KEY; events[n].code = BTN_MIDDLE; events[n++].value = frame->mmb; }
+  if(frame->x)        { events[n].type = EV_REL; events[n].code = REL_X;      events[n++].value = frame->x; }
+  if(frame->y)        { events[n].type = EV_REL; events[n].code = REL_Y;      events[n++].value = frame->y; }
+  if(frame->wheel)    { events[n].type = EV_REL; events[n].code = REL_WHEEL;  events[n++].value = frame->wheel; }
+  if(n == 0) { return 0; } // Real mice don't report idle frames either
+  events[n].type = EV_SYN;
+  events[n++].code = SYN_REPORT;
+  return n;
+}
+
+static uint64_t timespec_ns(struct timespec *ts) {
+  return (uint64_t)ts->tv_sec * NS_FULL_SECOND + ts->tv_nsec;
+}
+
+int main(int argc, char **argv) {
+  struct gen_opts options;
+  struct input_event events[FRAME_EVENTS_MAX];
+  gen_frame_t frame;
+  char mouse_path[64];
+  uint64_t frames = 0, sent = 0, late = 0, late_max = 0;
+
+  parse_opts(argc, argv, &options);
+
+  int mouse = uinput_mouse_create("amouse load generator", mouse_path, sizeof(mouse_path));
+  if(mouse < 0) {
+    fprintf(stderr, "uinput mouse create failed: %d: %s\n", errno, strerror(errno));
+    exit(-1);
+  }
+  printf("Virtual mouse at %s, pattern %s at %d Hz, starting in %d s.\n", mouse_path,
+    pattern_names[options.pattern], options.rate, options.delay);
+
+  struct sigaction sa = {0};
+  sa.sa_handler = handle_signal;
+  sigaction(SIGINT, &sa, NULL);
+  sigaction(SIGTERM, &sa, NULL);
+
+  struct timespec next, now;
+  uint64_t period = NS_FULL_SECOND / options.rate;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  uint64_t start = timespec_ns(&now) + (uint64_t)options.delay * NS_FULL_SECOND;
+  uint64_t end = start + (uint64_t)options.seconds * NS_FULL_SECOND;
+
+  // Frames go out on an absolute timeline, a late frame doesn't push back the following ones.
+  while(!quit_requested && (options.seconds == 0 || start + frames * period < end)) {
+    uint64_t target = start + frames * period;
+    next.tv_sec = target / NS_FULL_SECOND;
+    next.tv_nsec = target % NS_FULL_SECOND;
+    if(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL) != 0) { continue; }
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if(timespec_ns(&now) > target + period) {
+      late++;
+      if(timespec_ns(&now) - target > late_max) { late_max = timespec_ns(&now) - target; }
+    }
+
+    pattern_frame(&options, frames, &frame);
+    int num = frame_events(&frame, events);
+    if(num > 0 && uinput_write(mouse, events, num) < 0) {
+      fprintf(stderr, "uinput write failed: %d: %s\n", errno, strerror(errno));
+      break;
+    }
+    sent += num;
+    frames++;
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  double elapsed = (timespec_ns(&now) > start) ? (timespec_ns(&now) - start) / 1e9 : 1.0;
+  printf("Sent %llu frames (%llu events) in %.2f s, %.0f frames/s.\n", (unsigned long long)frames,
+    (unsigned long long)sent, elapsed, frames / elapsed);
+  printf("%llu frames more than a period late, worst %.3f ms.\n", (unsigned long long)late, late_max / 1e6);
+
+  uinput_mouse_destroy(mouse);
+  return 0;
+}
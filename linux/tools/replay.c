@@ -0,0 +1,264 @@
+/*
+ * Anachro Mouse, a usb to serial mouse adaptor. Copyright (C) 2025 Aviancer <oss+amouse@skyvian.me>
+ *
+ * This library is free software; you can redistribute it and/or modify it under the terms of the 
+ * GNU Lesser General Public License as published by the Free Software Foundation; either version 
+ * 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without 
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the 
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with this library; 
+ * if not, write to the Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*/
+
+/* replay.c: push a captured amouse trace (-T) through the shared mouse pipeline under a virtual clock.
+ *
+ * Packets are printed one per line with their time from start of the trace, so packet streams of 
+ * different builds or settings can be compared with diff. Nothing sleeps, a trace is replayed as 
+ * fast as it can be read.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+
+#include "../src/include/input.h"
+#include "../src/include/trace.h"
+#include "../../shared/mouse.h"
+#include "../../shared/pacing.h"
+#include "../../shared/settings.h"
+#include "../../shared/utils.h"
+
+typedef struct replay {
+  mouse_state_t mouse;
+  tx_schedule_t tx_schedule;
+  serial_line_t line;
+  uint64_t start;
+  int frames;
+  int packets;
+  bool quiet;
+
+  // Comparison against packets recorded in the trace
+  trace_map_t const *map;
+  size_t recorded_next;
+  int recorded_matched;
+  int recorded_differ;
+  int64_t delta_max; // Largest timing difference to recorded packet, ns
+} replay_t;
+
+// Settings given on command line, replacing those captured in the trace. -1 when not given.
+typedef struct replay_overrides {
+  int protocol;
+  int sensitivity;
+  int wheel_short;
+  int carry_decay;
+  int carry_cap;
+  int accel_curve;
+} replay_overrides_t;
+
+static void showhelp(char *argv[]) {
+  printf("Usage: %s [options] <trace>\n\n" \
+    "  -R Print packets recorded in the trace instead of replaying it\n" \
+    "  -s Summary only, don't print packets\n" \
+    "  -p <Proto num> Replay with another serial protocol\n" \
+    "  -r <1-30> Replay with another sensitivity\n" \
+    "  -w Replay with 3 byte MS wheel packets while wheel is idle\n" \
+    "  -c <0-2> Replay with motion carry-over and given decay\n" \
+    "  -C <0-3> Replay with carry-over backlog cap\n" \
+    "  -a <0-2> Replay with acceleration curve\n", argv[0]);
+}
+
+static void print_packet(uint64_t time_ns, uint8_t const *packet, int len) {
+  printf("%10llu.%03llu ms ", (unsigned long long)(time_ns / 1000000), (unsigned long long)((time_ns / 1000) % 1000));
+  for(int i=0; i < len; i++) { printf(" %02x", packet[i]); }
+  printf("\n");
+}
+
+// Match replayed packet against the next one the trace recorded.
+static void compare_recorded(replay_t *replay, uint64_t now) {
+  trace_record_t const *record;
+
+  while(replay->recorded_next < replay->map->count && replay->map->records[replay->recorded_next].type != TRACE_PACKET) {
+    replay->recorded_next++;
+  }
+  if(replay->recorded_next >= replay->map->count) { return; }
+  record = &replay->map->records[replay->recorded_next++];
+
+  if(record->len == replay->mouse.update && memcmp(record->packet, replay->mouse.state, record->len) == 0) {
+    replay->recorded_matched++;
+  }
+  else { replay->recorded_differ++; }
+
+  int64_t delta = (int64_t)now - (int64_t)record->time_ns;
+  if(delta < 0) { delta = -delta; }
+  if(delta > replay->delta_max) { replay->delta_max = delta; }
+}
+
+static void transmit(replay_t *replay, uint64_t now) {
+  encode_mouse_packet(&replay->mouse, &replay->tx_schedule, &replay->line, now);
+  if(replay->mouse.update > 0) {
+    if(!replay->quiet) { print_packet(now - replay->start, replay->mouse.state, replay->mouse.update); }
+    compare_recorded(replay, now);
+    replay->packets++;
+  }
+  reset_mouse_state(&replay->mouse);
+}
+
+// Send out everything the transmit schedule allows before given time, as the main loop timer would.
+static void run_until(replay_t *replay, uint64_t time_ns) {
+  while(replay->mouse.pc_state > CTS_LOW_INIT && replay->mouse.update > -1 && replay->tx_schedule.deadline <= time_ns) {
+    transmit(replay, (replay->tx_schedule.deadline > replay->start) ? replay->tx_schedule.deadline : replay->start);
+  }
+}
+
+static void replay_record(replay_t *replay, trace_record_t const *record) {
+  mouse_state_t *mouse = &replay->mouse;
+  uint64_t now = record->time_ns;
+  mouse_frame_t frame;
+
+  run_until(replay, now);
+
+  switch(record->type) {
+    case TRACE_FRAME:
+      trace_frame(record, &frame);
+      // Don't fold consecutive button changes into one packet, as amouse does.
+      if(frame_has_buttons(&frame) && mouse->force_update && (mouse->pc_state > CTS_LOW_INIT)) {
+        transmit(replay, now);
+      }
+      process_mouse_report(mouse, &frame);
+      runtime_settings(mouse);
+      replay->frames++;
+      break;
+    case TRACE_IDENT:
+      if(mouse->baud != MOUSE_BAUD_DEFAULT) { line_set_baud(&replay->line, MOUSE_BAUD_DEFAULT); }
+      tx_schedule_follow_line(&replay->tx_schedule, &replay->line);
+      reset_line_state(mouse);
+      reset_motion_backlog(mouse);
+      mouse->pc_state = CTS_TOGGLED;
+      break;
+    case TRACE_LINE:
+      if(mouse->baud != record->line.baud) { line_set_baud(&replay->line, record->line.baud); }
+      tx_schedule_follow_line(&replay->tx_schedule, &replay->line);
+      mouse->baud = record->line.baud;
+      mouse->report_rate = record->line.report_rate;
+      break;
+    case TRACE_SETTINGS:
+      trace_record_options(record, &g_mouse_options);
+      apply_mouse_options();
+      line_set_format(&replay->line, g_mouse_protocol[g_mouse_options.protocol].data_bits, 0, 1);
+      tx_schedule_follow_line(&replay->tx_schedule, &replay->line);
+      break;
+    default:
+      return; // Recorded packets are output, not input
+  }
+
+  // Button changes go out immediately, motion on its transmit slot.
+  if(mouse->pc_state > CTS_LOW_INIT) {
+    if((mouse->update > -1 && tx_schedule_due(&replay->tx_schedule, now)) || mouse->force_update) {
+      transmit(replay, now);
+    }
+  }
+}
+
+int main(int argc, char **argv) {
+  replay_overrides_t overrides = { -1, -1, -1, -1, -1, -1 };
+  bool print_recorded = false;
+  bool quiet = false;
+  int option_index;
+  scan_int_t scan_i;
+  trace_map_t map;
+
+  while((option_index = getopt(argc, argv, "hRsp:r:wc:C:a:")) != -1) {
+    switch(option_index) {
+      case 'R':
+        print_recorded = true;
+        break;
+      case 's':
+        quiet = true;
+        break;
+      case 'p':
+        scan_i = scan_int((uint8_t*)optarg, 0, 2, 1);
+        if(scan_i.found && scan_i.value < g_mouse_protocol_num) { overrides.protocol = scan_i.value; }
+        break;
+      case 'r':
+        scan_i = scan_int((uint8_t*)optarg, 0, 3, 2);
+        if(scan_i.found) { overrides.sensitivity = SENSITIVITY_FROM_TENTHS(clampi(scan_i.value, 1, 30)); }
+        break;
+      case 'w':
+        overrides.wheel_short = 1;
+        break;
+      case 'c':
+        scan_i = scan_int((uint8_t*)optarg, 0, 2, 1);
+        if(scan_i.found) { overrides.carry_decay = clampi(scan_i.value, CARRY_DECAY_NONE, CARRY_DECAY_STOP); }
+        break;
+      case 'C':
+        scan_i = scan_int((uint8_t*)optarg, 0, 2, 1);
+        if(scan_i.found) { overrides.carry_cap = clampi(scan_i.value, 0, 3); }
+        break;
+      case 'a':
+        scan_i = scan_int((uint8_t*)optarg, 0, 2, 1);
+        if(scan_i.found) { overrides.accel_curve = clampi(scan_i.value, ACCEL_LINEAR, ACCEL_CUSTOM); }
+        break;
+      default:
+        showhelp(argv); exit(0);
+    }
+  }
+  if(optind >= argc) { showhelp(argv); exit(0); }
+
+  if(!trace_map(argv[optind], &map)) {
+    fprintf(stderr, "Trace %s could not be read: %d: %s\n", argv[optind], errno, strerror(errno));
+    exit(-1);
+  }
+  if(map.count == 0) {
+    fprintf(stderr, "Trace %s is empty.\n", argv[optind]);
+    exit(-1);
+  }
+
+  if(print_recorded) {
+    for(size_t i=0; i < map.count; i++) {
+      if(map.records[i].type == TRACE_PACKET) {
+        print_packet(map.records[i].time_ns - map.records[0].time_ns, map.records[i].packet, map.records[i].len);
+      }
+    }
+    trace_unmap(&map);
+    return 0;
+  }
+
+  if(!trace_options(map.header, &g_mouse_options)) {
+    fprintf(stderr, "Trace settings are corrupt, replaying with defaults.\n");
+  }
+  if(overrides.protocol >= 0)    { g_mouse_options.protocol = overrides.protocol; }
+  if(overrides.sensitivity >= 0) { g_mouse_options.sensitivity = overrides.sensitivity; }
+  if(overrides.wheel_short >= 0) { g_mouse_options.wheel_short = overrides.wheel_short; }
+  if(overrides.carry_decay >= 0) { g_mouse_options.motion_carry = 1; g_mouse_options.carry_decay = overrides.carry_decay; }
+  if(overrides.carry_cap >= 0)   { g_mouse_options.carry_cap = overrides.carry_cap; }
+  if(overrides.accel_curve >= 0) { g_mouse_options.accel_curve = overrides.accel_curve; }
+  apply_mouse_options();
+
+  replay_t replay = {0};
+  replay.map = &map;
+  replay.quiet = quiet;
+  replay.start = map.records[0].time_ns;
+  replay.mouse.pc_state = CTS_UNINIT;
+  reset_mouse_state(&replay.mouse);
+  reset_line_state(&replay.mouse);
+  line_init(&replay.line, NS_FULL_SECOND, MOUSE_BAUD_DEFAULT, g_mouse_protocol[g_mouse_options.protocol].data_bits, 0, 1);
+  tx_schedule_init(&replay.tx_schedule, replay.start, line_time(&replay.line, 1));
+
+  for(size_t i=0; i < map.count; i++) {
+    replay_record(&replay, &map.records[i]);
+  }
+  run_until(&replay, UINT64_MAX); // Drain what was still aggregated at end of trace
+
+  fprintf(stderr, "Replayed %d frames into %d packets, protocol: %s\n", replay.frames, replay.packets, 
+    g_mouse_protocol[g_mouse_options.protocol].name);
+  fprintf(stderr, "Recorded packets: %d matching, %d differing, max timing difference %lld us\n", 
+    replay.recorded_matched, replay.recorded_differ, (long long)(replay.delta_max / 1000));
+
+  trace_unmap(&map);
+  return 0;
+}
@@ -0,0 +1,111 @@
+/*
+ * Anachro Mouse, a usb to serial mouse adaptor. Copyright (C) 2025 Aviancer <oss+amouse@skyvian.me>
+ *
+ * This library is free software; you can redistribute it and/or modify it under the terms of the 
+ * GNU Lesser General Public License as published by the Free Software Foundation; either version 
+ * 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without 
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the 
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with this library; 
+ * if not, write to the Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*/
+
+/* uinput.c: virtual mouse device for feeding amouse synthetic input */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/ioctl.h>
+#include <linux/uinput.h>
+
+#include "uinput.h"
+
+#define UINPUT_SETTLE_TRIES 100 // 10ms apart, for udev to create the device node
+
+// Find /dev/input/event* node of the created device through sysfs.
+static int uinput_event_path(int fd, char *event_path, size_t path_len) {
+  char sysname[64];
+  char sysdir[128];
+  struct dirent *entry;
+  DIR *dir;
+
+  if(ioctl(fd, UI_GET_SYSNAME(sizeof(sysname)), sysname) < 0) { return -1; }
+  snprintf(sysdir, sizeof(sysdir), "/sys/devices/virtual/input/%s", sysname);
+  if((dir = opendir(sysdir)) == NULL) { return -1; }
+
+  event_path[0] = '\0';
+  while((entry = readdir(dir)) != NULL) {
+    if(strncmp(entry->d_name, "event", 5) == 0) {
+      snprintf(event_path, path_len, "/dev/input/%s", entry->d_name);
+      break;
+    }
+  }
+  closedir(dir);
+  if(event_path[0] == '\0') {
+    errno = ENOENT;
+    return -1;
+  }
+
+  for(int i=0; i < UINPUT_SETTLE_TRIES && access(event_path, R_OK) != 0; i++) { usleep(10000); }
+  return access(event_path, R_OK);
+}
+
+// Create a three button wheel mouse, returns uinput fd and the event device amouse can open.
+int uinput_mouse_create(const char *name, char *event_path, size_t path_len) {
+  struct uinput_setup setup = {0};
+  int fd;
+
+  fd = open("/dev/uinput", O_WRONLY | O_NONBLOCK);
+  if(fd < 0) { return -1; }
+
+  ioctl(fd, UI_SET_EVBIT, EV_KEY);
+  ioctl(fd, UI_SET_KEYBIT, BTN_LEFT);
+  ioctl(fd, UI_SET_KEYBIT, BTN_RIGHT);
+  ioctl(fd, UI_SET_KEYBIT, BTN_MIDDLE);
+  ioctl(fd, UI_SET_EVBIT, EV_REL);
+  ioctl(fd, UI_SET_RELBIT, REL_X);
+  ioctl(fd, UI_SET_RELBIT, REL_Y);
+  ioctl(fd, UI_SET_RELBIT, REL_WHEEL);
+
+  setup.id.bustype = BUS_VIRTUAL;
+  setup.id.vendor = 0x1209; // pid.codes test VID
+  setup.id.product = 0x0001;
+  strncpy(setup.name, name, UINPUT_MAX_NAME_SIZE - 1);
+
+  if(ioctl(fd, UI_DEV_SETUP, &setup) < 0 || ioctl(fd, UI_DEV_CREATE) < 0) {
+    close(fd);
+    return -1;
+  }
+
+  if(uinput_event_path(fd, event_path, path_len) < 0) {
+    uinput_mouse_destroy(fd);
+    return -1;
+  }
+  return fd;
+}
+
+void uinput_mouse_destroy(int fd) {
+  ioctl(fd, UI_DEV_DESTROY);
+  close(fd);
+}
+
+int uinput_emit(int fd, int type, int code, int value) {
+  struct input_event ev = {0};
+
+  ev.type = type;
+  ev.code = code;
+  ev.value = value;
+  return uinput_write(fd, &ev, 1);
+}
+
+// Write a whole frame of events in one syscall, kernel timestamps them all alike.
+int uinput_write(int fd, struct input_event *events, int num) {
+  ssize_t len = num * sizeof(struct input_event);
+  return (write(fd, events, len) == len) ? 0 : -1;
+}
@@ -0,0 +1,32 @@
+/*
+ * Anachro Mouse, a usb to serial mouse adaptor. Copyright (C) 2025 Aviancer <oss+amouse@skyvian.me>
+ *
+ * This library is free software; you can redistribute it and/or modify it under the terms of the 
+ * GNU Lesser General Public License as published by the Free Software Foundation; either version 
+ * 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without 
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the 
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with this library; 
+ * if not, write to the Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*/
+
+#ifndef UINPUT_H_
+#define UINPUT_H_
+
+#include <stddef.h>
+#include <linux/input.h>
+
+/* Functions */
+
+int uinput_mouse_create(const char *name, char *event_path, size_t path_len);
+
+void uinput_mouse_destroy(int fd);
+
+int uinput_emit(int fd, int type, int code, int value);
+
+int uinput_write(int fd, struct input_event *events, int num);
+
+#endif // UINPUT_H_
@@ -22,18 +22,20 @@
 #include "stdbool.h"
 #include "pico/flash.h"
 #include "pico/stdlib.h"
-#include "pico/multicore.h"
-#include "pico/util/queue.h"
 #include "hardware/irq.h"
+#include "hardware/sync.h"
+#include "hardware/structs/scb.h"
 
 #include "include/version.h"
 #include "include/serial.h"
 #include "include/storage.h"
 #include "include/usb.h"
+#include "include/profile.h"
 #include "../shared/console.h"
 #include "../shared/utils.h"
 #include "../shared/mouse.h"
 #include "../shared/mouse_defs.h"
+#include "../shared/pacing.h"
 #include "../shared/settings.h"
 
 #include "bsp/board.h"
@@ -46,10 +48,18 @@
 
 mouse_state_t mouse; // int values default to 0 
 
-static uint32_t time_tx_target;  // Serial transmit timers target time
-static uint32_t time_rx_target;  // Serial receive timers target time
+static tx_schedule_t tx_schedule; // Serial transmit timeline (microseconds)
 
-uint8_t serial_buffer[2] = {0}; // Buffer for inputs from serial port.
+// Newest queued motion only packet, merged into the next packet if it hasn't gone out by then.
+static struct {
+  int x, y, wheel;
+  bool full;        // 4 byte packet
+  uint64_t airtime; // Timeline advance it took
+} tx_motion;
+
+uint8_t serial_buffer[8] = {0}; // Buffer for inputs from serial port.
+
+#define U_IDLE_MAX 10000 // Longest sleep without any wake source, keeps tinyusb housekeeping ticking
 
 // Aggregate movements before sending
 CFG_TUSB_MEM_SECTION static hid_mouse_report_t usb_mouse_report_prev;
@@ -59,11 +69,35 @@ bool led_state = false;
 
 /*** Timing ***/
 
-void queue_tx(mouse_state_t *mouse) {
-  // Update timer target for next transmit
-  // Use different send rate depending on protocol used (3 or 4 bytes)
-  if(mouse->update > 3) { time_tx_target = time_us_32() + U_SERIALDELAY_4B; }
-  else                  { time_tx_target = time_us_32() + U_SERIALDELAY_3B; }
+uint64_t queue_tx(mouse_state_t *mouse) {
+  // Advance transmit timeline by the packet just sent
+  // Packet takes its line time at current format, or longer if driver limited report rate
+  uint64_t airtime = packet_interval(mouse, line_airtime(&g_serial_line, mouse->update), U_FULL_SECOND);
+  tx_schedule_advance(&tx_schedule, time_us_64(), airtime);
+  return airtime;
+}
+
+// Latest state wins: motion packet still waiting in the ring is taken back and its motion goes out 
+// in this packet instead, so under load motion lags by at most the packet on the line.
+static void merge_waiting_motion(mouse_state_t *mouse) {
+  if(!serial_retract_motion(0)) { return; }
+
+  mouse->x += tx_motion.x;
+  mouse->y += tx_motion.y;
+  mouse->wheel += tx_motion.wheel;
+  push_update(mouse, tx_motion.full); // Keep wheel and middle button byte if taken back packet had one
+  tx_schedule_rewind(&tx_schedule, tx_motion.airtime);
+}
+
+// Sleep until there is something to do. USB host, CTS edges, serial receive and DMA completion all 
+// wake core0, a packet waiting on the transmit timeline sets an alarm for its deadline.
+static void idle_wait(mouse_state_t *mouse) {
+  bool running = mouse->pc_state > CTS_LOW_INIT;
+  if(running && mouse->force_update) { return; }
+
+  uint64_t wake = time_us_64() + U_IDLE_MAX;
+  if(running && mouse->update > -1) { wake = MIN(wake, tx_schedule.deadline); }
+  best_effort_wfe_or_timeout(from_us_since_boot(wake));
 }
 
 
@@ -120,48 +154,40 @@ static inline void process_mouse_report(mouse_state_t *mouse, hid_mouse_report_t
 // External interface for delivering mouse reports to process_mouse_report()
 // Allows keeping static context within amouse.c while tinyusb handling can be shifted to usb.c
 extern void collect_mouse_report(hid_mouse_report_t const* p_report) {
+  PROFILE_USB_REPORT();
+  PROFILE_BEGIN(PROF_REPORT);
   process_mouse_report(&mouse, p_report); // Passes full context with mouse and report without having to make them external/non-static.
+  PROFILE_END(PROF_REPORT);
 }
 
 
-/*** Core 1 thread to offload serial writes ***/
-
-void core1_tightloop() {
-  flash_safe_execute_core_init(); // Ensure core1 can be safetied for duration of writing to flash
-
-  uint8_t serial_data;
-  while(1) {
-    //serial_queue_pop(&g_serial_queue, &serial_data); // TODO: Test if returns correct data now
-    queue_remove_blocking(&g_serial_queue, &serial_data);
-    uart_putc_raw(uart0, serial_data); // TODO: Make UART configurable.
-  }
-}
-
 /*** Main init & loop ***/
 
 int main() {
 
-  // Initialize serial parameters 
-  mouse_serial_init(0); // uart0
+  PROFILE_INIT();
 
-  // Initialize the global serial data queue
-  queue_init(&g_serial_queue, sizeof(uint8_t), 80);
+  // Pending interrupts wake __wfe() even when masked in NVIC, see serial_wake_init().
+  scb_hw->scr |= M0PLUS_SCR_SEVONPEND_BITS;
 
-  // Should be launched before any interrupts
-  multicore_launch_core1(core1_tightloop);
+  // Initialize serial parameters, output goes out through DMA.
+  mouse_serial_init(0); // uart0
 
   // Set up initial state 
   //enable_pins(UART_RTS_BIT | UART_DTR_BIT);
   reset_mouse_state(&mouse);
+  reset_line_state(&mouse);
   mouse.pc_state = CTS_UNINIT;
 
   // Set safe default options, support mouse wheel.
   g_mouse_options.protocol = PROTO_MSWHEEL;
   g_mouse_options.wheel = 1;
-  g_mouse_options.sensitivity = 1.0;
+  g_mouse_options.sensitivity = SENSITIVITY_ONE;
 
   // Attempt to load saved settings from storage
   settings_decode(ptr_flash_settings(), &g_mouse_options);
+  apply_mouse_options();
+  serial_set_data_bits(0, g_mouse_protocol[g_mouse_options.protocol].data_bits);
 
   // Initialize USB
   tusb_init();
@@ -171,23 +197,34 @@ int main() {
   gpio_set_dir(LED_PIN, GPIO_OUT);
 
   // Set initial serial timer targets
-  time_tx_target = time_us_32() + U_SERIALDELAY_3B;
-  time_rx_target = time_us_32() + U_FULL_SECOND; 
+  // Allow lagging behind transmit timeline by up to a byte before re-anchoring.
+  tx_schedule_init(&tx_schedule, time_us_64(), line_time(&g_serial_line, 1));
 
   bool cts_pin = false;
 
   while(1) {
 
-    // Check for request for serial console
-    // Repeating non-blocking reads is slow so instead we queue checks every now and then with timer.
-    if(time_reached(time_rx_target)) {
-      if(serial_read(0, serial_buffer, 1) > 0) {
+    // Clear latched wake sources before looking at CTS and serial input
+    serial_wake_clear(0);
+
+    // Check for request for serial console, or Logitech driver commands
+    if(serial_readable(0)) {
+      int serial_len = serial_read(0, serial_buffer, sizeof(serial_buffer));
+      if(serial_len > 0) {
         // Use backspace to enable console instead of \n\r to avoid ATDT autodetection on Windows
-        if(serial_buffer[0] == '\b') {
+        if(console_requested(serial_buffer, serial_len)) {
     	    console(0);
+          tx_schedule_follow_line(&tx_schedule, &g_serial_line); // Protocol may have changed line format
+        }
+        else if(g_mouse_options.protocol == PROTO_LOGITECH) {
+          for(int i=0; i < serial_len; i++) {
+            if(logitech_command(&mouse, serial_buffer[i]) == LOGI_CMD_BAUD) {
+              serial_set_baud(0, mouse.baud);
+              tx_schedule_follow_line(&tx_schedule, &g_serial_line);
+            }
+          }
         }
       }
-      time_rx_target = time_us_32() + U_FULL_SECOND;
     }
 
     // Mouse handling
@@ -203,7 +240,14 @@ int main() {
     if(!cts_pin && (mouse.pc_state != CTS_UNINIT && mouse.pc_state != CTS_TOGGLED)) {
       gpio_put(LED_PIN, false); // DEBUG
       mouse.pc_state = CTS_TOGGLED;
+      // Driver init puts the mouse back to default line rate
+      if(mouse.baud != MOUSE_BAUD_DEFAULT) {
+        serial_set_baud(0, MOUSE_BAUD_DEFAULT);
+        tx_schedule_follow_line(&tx_schedule, &g_serial_line);
+      }
+      reset_line_state(&mouse);
       mouse_ident(0, g_mouse_options.wheel);
+      reset_motion_backlog(&mouse); // Drop movement aggregated while driver was not listening.
     }
 
     // Transmit only once we are initialized at least once. Unlike in DOS, Windows drivers will set CTS pin 
@@ -213,19 +257,43 @@ int main() {
       	led_state = true;
       }
 
+      PROFILE_BEGIN(PROF_TUH_TASK);
       tuh_task(); // tinyusb host task
+      PROFILE_END(PROF_TUH_TASK);
+
+      bool buttons_changed = mouse.force_update;
 
-      if(time_reached(time_tx_target) || mouse.force_update) {
+      // Motion waits for room in a full ring instead of blocking, deltas keep aggregating meanwhile.
+      if(!buttons_changed && mouse.update > -1 && serial_tx_full(0)) {
+        tx_schedule_defer(&tx_schedule, time_us_64(), line_time(&g_serial_line, 1));
+      }
+      else if((mouse.update > -1 && tx_schedule_due(&tx_schedule, time_us_64())) || buttons_changed) {
         runtime_settings(&mouse);
+        PROFILE_BEGIN(PROF_ENCODE);
       	input_sensitivity(&mouse);
+        merge_waiting_motion(&mouse);
 	      update_mouse_state(&mouse);
-
-      	queue_tx(&mouse); // Update next serial timing
-	      if(mouse.update > 0) { serial_write(0, mouse.state, mouse.update); }
+        PROFILE_END(PROF_ENCODE);
+
+	      if(mouse.update > 0) { 
+          uint64_t airtime = queue_tx(&mouse); // Update next serial timing
+          PROFILE_BEGIN(PROF_QUEUE_ADD);
+          if(buttons_changed) { serial_write(0, mouse.state, mouse.update); } // Button changes always go out in order
+          else {
+            tx_motion.x = mouse.x;
+            tx_motion.y = mouse.y;
+            tx_motion.wheel = mouse.wheel;
+            tx_motion.full = (mouse.update > 3);
+            tx_motion.airtime = airtime;
+            serial_write_motion(0, mouse.state, mouse.update);
+          }
+          PROFILE_END(PROF_QUEUE_ADD);
+        }
         reset_mouse_state(&mouse);
       }
     }
 
+    idle_wait(&mouse);
   }
 
   return(0);
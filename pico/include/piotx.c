@@ -0,0 +1,86 @@
+/*
+ * Anachro Mouse, a usb to serial mouse adaptor. Copyright (C) 2025 Aviancer <oss+amouse@skyvian.me>
+ *
+ * This library is free software; you can redistribute it and/or modify it under the terms of the 
+ * GNU Lesser General Public License as published by the Free Software Foundation; either version 
+ * 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without 
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the 
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with this library; 
+ * if not, write to the Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+*/
+
+/* piotx.c: UART transmit from PIO state machines */
+
+#include "pico/stdlib.h"
+#include "hardware/clocks.h"
+
+#include "piotx.h"
+
+#ifdef AMOUSE_PIO_TX
+
+#include "uart_tx.pio.h"
+
+#define PIOTX_PIO pio0
+
+static int program_offset = -1;
+
+// Claim a state machine and start it idling high on pin. Returns false if PIO is out of resources.
+bool piotx_init(piotx_port_t *port, uint pin, uint baud, int data_bits) {
+  if(program_offset < 0) {
+    if(!pio_can_add_program(PIOTX_PIO, &amouse_uart_tx_program)) { return false; }
+    program_offset = pio_add_program(PIOTX_PIO, &amouse_uart_tx_program);
+  }
+
+  int sm = pio_claim_unused_sm(PIOTX_PIO, false);
+  if(sm < 0) { return false; }
+
+  port->pio = PIOTX_PIO;
+  port->sm = sm;
+  port->pin = pin;
+
+  amouse_uart_tx_program_init(PIOTX_PIO, sm, program_offset, pin, baud, data_bits);
+  return true;
+}
+
+// Callers wait for the port to go idle first, a frame in flight would change speed mid byte.
+void piotx_set_baud(piotx_port_t *port, uint baud) {
+  pio_sm_set_clkdiv(port->pio, port->sm, (float)clock_get_hz(clk_sys) / (8 * baud));
+  pio_sm_clkdiv_restart(port->pio, port->sm);
+}
+
+// Bit count lives in Y, the state machine is stopped while it's replaced. Port must be idle.
+void piotx_set_data_bits(piotx_port_t *port, int data_bits) {
+  pio_sm_set_enabled(port->pio, port->sm, false);
+  pio_sm_exec(port->pio, port->sm, pio_encode_set(pio_y, data_bits - 1));
+  pio_sm_exec(port->pio, port->sm, pio_encode_jmp(program_offset));
+  pio_sm_set_enabled(port->pio, port->sm, true);
+}
+
+// Clear the sticky TX stall flag once new data is in the FIFO, so a stall from before doesn't read 
+// as idle. Flag sets again on every cycle the state machine sits stalled, clearing late is harmless.
+void piotx_mark_busy(piotx_port_t *port) {
+  port->pio->fdebug = 1u << (PIO_FDEBUG_TXSTALL_LSB + port->sm);
+}
+
+// All data has been framed out: FIFO is empty and the state machine has stalled on pull since the 
+// last piotx_mark_busy(). Stall is in the last cycle of the stop bit, the line is free by then.
+bool piotx_idle(piotx_port_t *port) {
+  return pio_sm_is_tx_fifo_empty(port->pio, port->sm) && 
+    (port->pio->fdebug & (1u << (PIO_FDEBUG_TXSTALL_LSB + port->sm)));
+}
+
+// DMA destination, byte writes are replicated across the word and the program shifts out the low bits.
+volatile void* piotx_txf(piotx_port_t *port) {
+  return &port->pio->txf[port->sm];
+}
+
+uint piotx_dreq(piotx_port_t *port) {
+  return pio_get_dreq(port->pio, port->sm, true);
+}
+
+#endif // AMOUSE_PIO_TX
@@ -0,0 +1,48 @@
+/*
+ * Anachro Mouse, a usb to serial mouse adaptor. Copyright (C) 2025 Aviancer <oss+amouse@skyvian.me>
+ *
+ * This library is free software; you can redistribute it and/or modify it under the terms of the 
+ * GNU Lesser General Public License as published by the Free Software Foundation; either version 
+ * 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without 
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the 
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with this library; 
+ * if not, write to the Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+*/
+
+#ifndef PIOTX_H_
+#define PIOTX_H_
+
+#include "hardware/pio.h"
+
+// PIO UART transmitter, enabled with cmake -DAMOUSE_PIO_TX=ON. Framing is timed by the state machine
+// clock and whether the line is idle comes from the state machine itself, stalled on an empty FIFO.
+// No per byte interrupts. Any free GPIO can be a port, more than the two hardware UARTs allow.
+
+typedef struct piotx_port {
+  PIO  pio;
+  uint sm;
+  uint pin;
+} piotx_port_t;
+
+/* Functions */
+
+bool piotx_init(piotx_port_t *port, uint pin, uint baud, int data_bits);
+
+void piotx_set_baud(piotx_port_t *port, uint baud);
+
+void piotx_set_data_bits(piotx_port_t *port, int data_bits);
+
+void piotx_mark_busy(piotx_port_t *port);
+
+bool piotx_idle(piotx_port_t *port);
+
+volatile void* piotx_txf(piotx_port_t *port);
+
+uint piotx_dreq(piotx_port_t *port);
+
+#endif // PIOTX_H_
@@ -0,0 +1,120 @@
+/*
+ * Anachro Mouse, a usb to serial mouse adaptor. Copyright (C) 2025 Aviancer <oss+amouse@skyvian.me>
+ *
+ * This library is free software; you can redistribute it and/or modify it under the terms of the 
+ * GNU Lesser General Public License as published by the Free Software Foundation; either version 
+ * 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without 
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the 
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with this library; 
+ * if not, write to the Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+*/
+
+/* profile.c: Cycle counters for the firmware hot path */
+
+#include <string.h>
+
+#include "pico/stdlib.h"
+
+#include "profile.h"
+
+#ifdef AMOUSE_PROFILE
+
+#include "hardware/regs/m0plus.h"
+
+#include "serial.h"
+#include "../shared/utils.h"
+
+#define SYSTICK_MASK 0x00FFFFFF
+
+typedef struct profile_counter {
+  uint32_t min, max, count;
+  uint64_t sum;
+} profile_counter_t;
+
+static profile_counter_t stages[PROF_STAGES]; // CPU cycles
+static profile_counter_t usb_interval;       // Microseconds between USB mouse reports
+static uint32_t usb_report_prev;
+static uint queue_high_water;
+
+static const char *stage_names[PROF_STAGES] = {
+  "tuh_task:  ",
+  "report:    ",
+  "encode:    ",
+  "queue add: "
+};
+
+static void counter_add(profile_counter_t *counter, uint32_t value) {
+  if(counter->count == 0 || value < counter->min) { counter->min = value; }
+  if(value > counter->max) { counter->max = value; }
+  counter->sum += value;
+  counter->count++;
+}
+
+void profile_init(void) {
+  systick_hw->rvr = SYSTICK_MASK;
+  systick_hw->cvr = 0;
+  systick_hw->csr = M0PLUS_SYST_CSR_CLKSOURCE_BITS | M0PLUS_SYST_CSR_ENABLE_BITS; // CPU clock, no interrupt
+  profile_reset();
+}
+
+void profile_reset(void) {
+  memset(stages, 0, sizeof(stages));
+  memset(&usb_interval, 0, sizeof(usb_interval));
+  usb_report_prev = 0;
+  queue_high_water = 0;
+}
+
+void profile_stage_end(int stage, uint32_t begin) {
+  counter_add(&stages[stage], (begin - systick_hw->cvr) & SYSTICK_MASK); // Counts down
+}
+
+void profile_usb_report(void) {
+  uint32_t now = time_us_32();
+  if(usb_report_prev != 0) { counter_add(&usb_interval, now - usb_report_prev); }
+  usb_report_prev = now;
+}
+
+void profile_queue_level(uint level) {
+  if(level > queue_high_water) { queue_high_water = level; }
+}
+
+static void profile_print_counter(int fd, const char *name, profile_counter_t *counter, const char *unit) {
+  char itoa_buffer[11] = {0};
+
+  serial_write_terminal(fd, (uint8_t*)name, strlen(name));
+  serial_write_terminal(fd, (uint8_t*)"min ", 4);
+  itoa(counter->min, itoa_buffer, sizeof(itoa_buffer) - 1);
+  serial_write_terminal(fd, (uint8_t*)itoa_buffer, strlen(itoa_buffer));
+  serial_write_terminal(fd, (uint8_t*)" avg ", 5);
+  itoa((counter->count) ? (uint32_t)(counter->sum / counter->count) : 0, itoa_buffer, sizeof(itoa_buffer) - 1);
+  serial_write_terminal(fd, (uint8_t*)itoa_buffer, strlen(itoa_buffer));
+  serial_write_terminal(fd, (uint8_t*)" max ", 5);
+  itoa(counter->max, itoa_buffer, sizeof(itoa_buffer) - 1);
+  serial_write_terminal(fd, (uint8_t*)itoa_buffer, strlen(itoa_buffer));
+  serial_write_terminal(fd, (uint8_t*)unit, strlen(unit));
+}
+
+void profile_print(int fd) {
+  char itoa_buffer[11] = {0};
+
+  serial_write_terminal(fd, (uint8_t*)"[Profile]\n", 10);
+  for(int i=0; i < PROF_STAGES; i++) {
+    profile_print_counter(fd, stage_names[i], &stages[i], " cycles\n");
+  }
+  profile_print_counter(fd, "USB interval: ", &usb_interval, " us\n");
+
+  itoa(usb_interval.count, itoa_buffer, sizeof(itoa_buffer) - 1);
+  serial_write_terminal(fd, (uint8_t*)"USB reports: ", 13);
+  serial_write_terminal(fd, (uint8_t*)itoa_buffer, strlen(itoa_buffer));
+  itoa(queue_high_water, itoa_buffer, sizeof(itoa_buffer) - 1);
+  serial_write_terminal(fd, (uint8_t*)"\nSerial ring high-water: ", 25);
+  serial_write_terminal(fd, (uint8_t*)itoa_buffer, strlen(itoa_buffer));
+  serial_write_terminal(fd, (uint8_t*)" chunks\n", 8);
+}
+
+#endif // AMOUSE_PROFILE
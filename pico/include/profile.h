@@ -0,0 +1,63 @@
+/*
+ * Anachro Mouse, a usb to serial mouse adaptor. Copyright (C) 2025 Aviancer <oss+amouse@skyvian.me>
+ *
+ * This library is free software; you can redistribute it and/or modify it under the terms of the 
+ * GNU Lesser General Public License as published by the Free Software Foundation; either version 
+ * 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without 
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the 
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with this library; 
+ * if not, write to the Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+*/
+
+#ifndef PROFILE_H_
+#define PROFILE_H_
+
+// Hot path profiling, enabled with cmake -DAMOUSE_PROFILE=ON. When disabled the macros compile to nothing.
+
+enum PROFILE_STAGES {
+  PROF_TUH_TASK  = 0, // tinyusb host task, includes report callbacks
+  PROF_REPORT    = 1, // process_mouse_report()
+  PROF_ENCODE    = 2, // Sensitivity, acceleration and packet encoding
+  PROF_QUEUE_ADD = 3, // Handing packet to transmit ring
+  PROF_STAGES    = 4
+};
+
+#ifdef AMOUSE_PROFILE
+
+#include "hardware/structs/systick.h"
+
+// SysTick counts down from 0xFFFFFF at CPU clock, wraps every ~134ms at 125MHz.
+#define PROFILE_INIT()       profile_init()
+#define PROFILE_BEGIN(stage) uint32_t profile_begin_##stage = systick_hw->cvr
+#define PROFILE_END(stage)   profile_stage_end(stage, profile_begin_##stage)
+#define PROFILE_USB_REPORT() profile_usb_report()
+#define PROFILE_QUEUE_LEVEL(level) profile_queue_level(level)
+
+void profile_init(void);
+
+void profile_reset(void);
+
+void profile_stage_end(int stage, uint32_t begin);
+
+void profile_usb_report(void);
+
+void profile_queue_level(uint level);
+
+void profile_print(int fd);
+
+#else
+
+#define PROFILE_INIT()
+#define PROFILE_BEGIN(stage)
+#define PROFILE_END(stage)
+#define PROFILE_USB_REPORT()
+#define PROFILE_QUEUE_LEVEL(level)
+
+#endif // AMOUSE_PROFILE
+
+#endif // PROFILE_H_
@@ -15,27 +15,50 @@
 */
 
 #include "pico/stdlib.h"
-#include "pico/multicore.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+#include "hardware/sync.h"
+#include <string.h>
 
 #include "serial.h"
 #include "../shared/mouse.h"
+#include "../shared/txring.h"
 #include "include/wrappers.h"
+#include "include/profile.h"
+#include "include/piotx.h"
 
 // Map for iterating through each bit (index) for pin (value)  
 // Should be updated to reflect UART_..._PIN values.
 const int UART_BITS2PINS[] = {0,1,3,4,5,6};
 const uint UART_BITS2PINS_LENGTH = 6;
 
-// For queue purposes we need something that can be referred to with pointer
-const uint8_t chr_carriage_return = (uint8_t)'\r';
-
 #define BAUD_RATE 1200
-#define DATA_BITS 7
+#define DATA_BITS 7 // Until protocol is known
 #define STOP_BITS 1
 #define PARITY UART_PARITY_NONE
 
-// Multi-core serial data queue 
-queue_t g_serial_queue;
+// Serial output waiting for DMA, whole packets and chunks of console text
+tx_ring_t g_tx_ring;
+
+// DMA transmit engine, paced by UART or PIO TX DREQ. Completion interrupt hands out the next chunk.
+// With the PIO transmitter each chunk can also go out on a mirror pin, one DMA channel per port.
+#if defined(AMOUSE_PIO_TX) && defined(AMOUSE_PIO_MIRROR_PIN) && AMOUSE_PIO_MIRROR_PIN >= 0
+#define TX_PORTS 2
+#else
+#define TX_PORTS 1
+#endif
+
+static int tx_dma_chan[TX_PORTS];
+static int tx_ports_active = 0;               // Ports with a DMA channel, mirror may be missing
+static uint32_t tx_dma_mask = 0;              // All transmit channels, 0 until initialized
+static volatile uint32_t tx_busy = 0;         // Channels still working on the current chunk
+static volatile uint64_t tx_line_free_us = 0; // When the last byte handed to UART has left the line
+
+#ifdef AMOUSE_PIO_TX
+static piotx_port_t tx_ports[TX_PORTS];
+#endif
+
+serial_line_t g_serial_line; // Line timing in microseconds
 
 /*** Serial comms ***/
 
@@ -52,7 +75,11 @@ void mouse_serial_init(int uart_id) {
     // Set baud for serial device 
     uart_init(uart, BAUD_RATE);
 
+#ifdef AMOUSE_PIO_TX
+    // UART only receives, TX pin belongs to the PIO transmitter set up in serial_tx_init().
+#else
     gpio_set_function(UART_TX_PIN, GPIO_FUNC_UART);
+#endif
     gpio_set_function(UART_RX_PIN, GPIO_FUNC_UART);
     
     // Set UART flow control CTS/RTS off 
@@ -61,44 +88,209 @@ void mouse_serial_init(int uart_id) {
     uart_set_translate_crlf(uart, false);
     // 7n1
     uart_set_format(uart, DATA_BITS, STOP_BITS, PARITY);
+    line_init(&g_serial_line, U_FULL_SECOND, BAUD_RATE, DATA_BITS, 0, STOP_BITS);
 
-    // Having the FIFOs on causes lag with 4 byte packets, this ensures better flow.
+    // Having the FIFOs on causes lag with 4 byte packets, this ensures better flow. Without FIFO DMA 
+    // also completes only once the last byte is in the transmitter, so we know when the line frees up.
     uart_set_fifo_enabled(uart, false);
+
+    serial_tx_init(uart);
+    serial_wake_init(uart_id);
   }
 }
 
-int serial_write(int uart_id, uint8_t *buffer, int size) {
-  // For now uart is what gets set in Core 1 loop.
+/*** Wake sources ***/
+
+// Receive and CTS edge interrupts are enabled in the peripherals but not in NVIC. With SEVONPEND set 
+// the pending interrupt alone wakes core0 from __wfe(), no handlers needed. Sources stay latched until 
+// serial_wake_clear().
+void serial_wake_init(int uart_id) {
+  uart_inst_t* uart = get_uart(uart_id);
+  if(uart == NULL) { return; }
+
+  uart_set_irq_enables(uart, true, false);
+  gpio_set_irq_enabled(UART_CTS_PIN, GPIO_IRQ_EDGE_RISE | GPIO_IRQ_EDGE_FALL, true);
+}
+
+// Call before sampling CTS and reading, so anything arriving after that wakes us again.
+// Unread receive data keeps the UART interrupt asserted and pends it straight back.
+void serial_wake_clear(int uart_id) {
+  gpio_acknowledge_irq(UART_CTS_PIN, GPIO_IRQ_EDGE_RISE | GPIO_IRQ_EDGE_FALL);
+  irq_clear(IO_IRQ_BANK0);
+  irq_clear((uart_id == 0) ? UART0_IRQ : UART1_IRQ);
+}
+
+bool serial_readable(int uart_id) {
+  uart_inst_t* uart = get_uart(uart_id);
+  return (uart != NULL) && uart_is_readable(uart);
+}
+
+/*** DMA transmit ***/
+
+// Start transfer of the oldest chunk if DMA is idle. Called with interrupts disabled or from the DMA IRQ.
+static void tx_kick() {
+  tx_chunk_t const *chunk;
+  if(tx_busy || (chunk = tx_ring_peek(&g_tx_ring)) == NULL) { return; }
+
+  for(int i=0; i < tx_ports_active; i++) {
+    dma_channel_set_read_addr(tx_dma_chan[i], chunk->data, false);
+    dma_channel_set_trans_count(tx_dma_chan[i], chunk->len, false);
+  }
+  tx_busy = tx_dma_mask;
+  dma_start_channel_mask(tx_dma_mask);
+}
+
+static void __isr tx_dma_irq_handler() {
+  uint32_t done = dma_hw->ints0 & tx_dma_mask;
+  if(!done) { return; }
+  dma_hw->ints0 = done;
+  tx_busy &= ~done;
+  if(tx_busy) { return; } // Mirror still sending
+
+#ifdef AMOUSE_PIO_TX
+  // Last byte was just written, state machines are busy with it for a whole frame. Any stall seen
+  // from here on means the chunk is out.
+  for(int i=0; i < tx_ports_active; i++) { piotx_mark_busy(&tx_ports[i]); }
+#endif
+
+  // Last byte is in the holding register, behind at most one byte still shifting out.
+  tx_line_free_us = time_us_64() + line_time(&g_serial_line, 2);
+  tx_ring_release(&g_tx_ring);
+  tx_kick();
+}
+
+// Set up DMA channel for port, chunks set source and length.
+static void tx_dma_init(int port, volatile void *dest, uint dreq) {
+  tx_dma_chan[port] = dma_claim_unused_channel(true);
+  dma_channel_config config = dma_channel_get_default_config(tx_dma_chan[port]);
+  channel_config_set_transfer_data_size(&config, DMA_SIZE_8);
+  channel_config_set_read_increment(&config, true);
+  channel_config_set_write_increment(&config, false);
+  channel_config_set_dreq(&config, dreq);
+  dma_channel_configure(tx_dma_chan[port], &config, dest, NULL, 0, false);
+
+  dma_channel_set_irq0_enabled(tx_dma_chan[port], true);
+  tx_dma_mask |= 1u << tx_dma_chan[port];
+  tx_ports_active++;
+}
+
+// Whether every byte handed to the transmitter has been framed out. UART can't tell, there the 
+// line free time estimated at DMA completion has to do.
+static bool tx_frames_done() {
+#ifdef AMOUSE_PIO_TX
+  return piotx_idle(&tx_ports[0]);
+#else
+  return true;
+#endif
+}
+
+void serial_tx_init(uart_inst_t *uart) {
+  if(tx_dma_mask) { return; }
+  tx_ring_init(&g_tx_ring);
+
+#ifdef AMOUSE_PIO_TX
+  if(!piotx_init(&tx_ports[0], UART_TX_PIN, g_serial_line.baud, DATA_BITS)) { panic("No PIO for serial transmit"); }
+  tx_dma_init(0, piotx_txf(&tx_ports[0]), piotx_dreq(&tx_ports[0]));
+#if TX_PORTS > 1
+  // Mirror is optional, carry on without it if PIO is out of state machines.
+  if(piotx_init(&tx_ports[1], AMOUSE_PIO_MIRROR_PIN, g_serial_line.baud, DATA_BITS)) {
+    tx_dma_init(1, piotx_txf(&tx_ports[1]), piotx_dreq(&tx_ports[1]));
+  }
+#endif
+#else
+  tx_dma_init(0, &uart_get_hw(uart)->dr, uart_get_dreq(uart, true));
+#endif
+
+  irq_add_shared_handler(DMA_IRQ_0, tx_dma_irq_handler, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+  irq_set_enabled(DMA_IRQ_0, true);
+}
+
+// Claim next ring slot, sleeping until DMA frees one if the ring is full.
+static tx_chunk_t* tx_claim_blocking() {
+  tx_chunk_t *chunk;
+  while((chunk = tx_ring_claim(&g_tx_ring)) == NULL) { __wfe(); } // DMA completion interrupt wakes us
+  return chunk;
+}
+
+// Publish chunk and start DMA on it, unless a transfer is already running.
+static void tx_publish(int len, int type) {
+  tx_ring_publish(&g_tx_ring, len, type);
+
+  uint32_t irq_state = save_and_disable_interrupts();
+  tx_kick();
+  restore_interrupts(irq_state);
+}
+
+static int serial_write_chunks(uint8_t *buffer, int size, int type) {
   int bytes=0;
-  for(; bytes < size; bytes++) {
-    // Offload serial write to Core 1
-    queue_add_blocking(&g_serial_queue, &buffer[bytes]);
+  while(bytes < size) {
+    // Packets fit in a single chunk
+    int len = MIN(size - bytes, TX_CHUNK_MAX);
+    tx_chunk_t *chunk = tx_claim_blocking();
+    memcpy(chunk->data, &buffer[bytes], len);
+    tx_publish(len, type);
+    bytes += len;
   }
+  PROFILE_QUEUE_LEVEL(tx_ring_level(&g_tx_ring));
   return bytes;
 }
 
+int serial_write(int uart_id, uint8_t *buffer, int size) {
+  // For now uart is the one DMA was set up for in mouse_serial_init().
+  return serial_write_chunks(buffer, size, TX_CHUNK_PACKET);
+}
+
+// Queue packet without button changes, a newer one may still take it back with serial_retract_motion().
+// Check serial_tx_full() first, this only blocks when the ring is full.
+int serial_write_motion(int uart_id, uint8_t *buffer, int size) {
+  return serial_write_chunks(buffer, size, TX_CHUNK_MOTION);
+}
+
+// Take back the newest motion packet if DMA hasn't started on it, so the next packet can carry its 
+// motion instead. Returns true if it was taken back.
+bool serial_retract_motion(int uart_id) {
+  uint32_t irq_state = save_and_disable_interrupts(); // DMA interrupt is the consumer
+  bool retracted = tx_ring_retract(&g_tx_ring, TX_CHUNK_MOTION);
+  restore_interrupts(irq_state);
+  return retracted;
+}
+
+bool serial_tx_full(int uart_id) {
+  return tx_ring_level(&g_tx_ring) >= TX_RING_SIZE;
+}
+
 /* Write to serial out with convert terminal characters */
 int serial_write_terminal(int uart_id, uint8_t *buffer, int size) { 
-  // For now uart is what gets set in Core 1 loop.
-  //uart_inst_t* uart = get_uart(uart_id);
+  // For now uart is the one DMA was set up for in mouse_serial_init().
+  tx_chunk_t *chunk = NULL;
+  int len = 0;
   int bytes=0;
   for(int pos=0; pos <= size; pos++) {
-    if(buffer[pos] == '\0') { return bytes; }
+    if(buffer[pos] == '\0') { break; }
+    // Room for CRLF in chunk, otherwise hand it over and start a new one.
+    if(chunk != NULL && len > TX_CHUNK_MAX - 2) {
+      tx_publish(len, TX_CHUNK_TEXT);
+      chunk = NULL;
+    }
+    if(chunk == NULL) {
+      chunk = tx_claim_blocking();
+      len = 0;
+    }
     // Convert LF to CRLF
-    else if(buffer[pos] == '\n') {
-      queue_add_blocking(&g_serial_queue, &chr_carriage_return);
+    if(buffer[pos] == '\n') {
+      chunk->data[len++] = '\r';
       bytes++;
     }
-    // Offload serial write to Core 1
-    queue_add_blocking(&g_serial_queue, &buffer[pos]);
+    chunk->data[len++] = buffer[pos];
     bytes++;
   } 
+  if(chunk != NULL) { tx_publish(len, TX_CHUNK_TEXT); }
   return bytes;
 }
 
 // Wait for any current serial transmission in the queue to be done
 // Allows defining max_wait_us for timeout
-bool serial_waitfor_tx(uint32_t max_wait_us) {
+bool serial_waitfor_tx(int uart_id, uint32_t max_wait_us) {
   bool time_rollover = false;
   static uint32_t time_timeout;
   time_timeout = time_us_32() + max_wait_us; // Can wrap
@@ -115,11 +307,45 @@ bool serial_waitfor_tx(uint32_t max_wait_us) {
     else { time_rollover = false; }
 
     if (time_us_32() > time_timeout) { return false; } // Timed out
-  } while(!queue_is_empty(&g_serial_queue));
+  } while(tx_busy || !tx_ring_empty(&g_tx_ring) || !tx_frames_done());
+
+#ifndef AMOUSE_PIO_TX // PIO stalls in the last cycle of the stop bit, nothing left to wait for there
+  // DMA being done only means the last byte was handed to UART, wait for it to leave the line.
+  uint64_t line_free = tx_line_free_us;
+  if(time_us_64() < line_free) { sleep_us(line_free - time_us_64()); }
+  uart_inst_t* uart = get_uart(uart_id);
+  if(uart != NULL) { uart_tx_wait_blocking(uart); }
+#endif
 
   return true; // Finished within timeout
 }
 
+// Switch between 7N1 and 8N1, after anything already queued has gone out in the previous format.
+void serial_set_data_bits(int uart_id, int data_bits) {
+  uart_inst_t* uart = get_uart(uart_id);
+  if(uart == NULL) { return; }
+
+  serial_waitfor_tx(uart_id, U_FULL_SECOND);
+  uart_set_format(uart, data_bits, STOP_BITS, PARITY);
+#ifdef AMOUSE_PIO_TX
+  for(int i=0; i < tx_ports_active; i++) { piotx_set_data_bits(&tx_ports[i], data_bits); }
+#endif
+  line_set_format(&g_serial_line, data_bits, 0, STOP_BITS);
+}
+
+// Change line rate for host requested baud, after anything already queued has gone out at the old rate.
+void serial_set_baud(int uart_id, uint32_t baud) {
+  uart_inst_t* uart = get_uart(uart_id);
+  if(uart == NULL) { return; }
+
+  serial_waitfor_tx(uart_id, U_FULL_SECOND);
+  uart_set_baudrate(uart, baud);
+#ifdef AMOUSE_PIO_TX
+  for(int i=0; i < tx_ports_active; i++) { piotx_set_baud(&tx_ports[i], baud); }
+#endif
+  line_set_baud(&g_serial_line, baud);
+}
+
 // Non-blocking read
 int serial_read(int uart_id, uint8_t *buffer, int size) { 
   uart_inst_t* uart = get_uart(uart_id);
@@ -136,13 +362,6 @@ int serial_read(int uart_id, uint8_t *buffer, int size) {
   return bytes;
 }
 
-/* Pop the next entry from the serial data queue */
-// Prefer less direct access to queue internals from rest of the program,
-// for the moment just a wrap-around but easier to work with as a endpoint for changes later.
-void serial_queue_pop(queue_t *queue, uint8_t *buffer) {
-  queue_remove_blocking(queue, buffer); // TODO: Test if returns correct data now
-}
-
 int get_pins(int flag) {
   int serial_state = 0;
   /*  serial_state |= (gpio_get(UART_TX_PIN)  << UART_TX_BIT);
@@ -182,10 +401,10 @@ void mouse_ident(int uart_id, bool wheel_enabled) {
  
   if(g_mouse_options.protocol == PROTO_MSWHEEL) {
     int bytes=0;
-    for(; bytes < g_pkt_intellimouse_intro_len; bytes++) {
+    while(bytes < g_pkt_intellimouse_intro_len) {
       // Interrupt long write if no longer requested to ident.
       if(gpio_get(UART_CTS_PIN)) { break; } 
-      queue_add_blocking(&g_serial_queue, &g_pkt_intellimouse_intro[bytes]);
+      bytes += serial_write(uart_id, &g_pkt_intellimouse_intro[bytes], MIN(g_pkt_intellimouse_intro_len - bytes, TX_CHUNK_MAX));
     }
   }
   else {
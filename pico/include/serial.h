@@ -17,7 +17,8 @@
 #ifndef SERIAL_H_
 #define SERIAL_H_
 
-#include "pico/util/queue.h"
+#include "../shared/pacing.h"
+#include "../shared/txring.h"
 
 // Which pin has which function
 // Serial spec (Fem): TX(2), RX(3), DSR(4), DTR(6), CTS(7), RTS(8)
@@ -43,7 +44,9 @@ enum UART_BITS {
   UART_RTS_BIT = 6
 };
 
-extern queue_t g_serial_queue; // Global serial data queue
+extern tx_ring_t g_tx_ring; // Serial output waiting for DMA transmit
+
+extern serial_line_t g_serial_line; // Current line format, kept up to date on reconfiguring the UART
 
 uart_inst_t* get_uart(int uart_id);
 
@@ -51,13 +54,29 @@ void mouse_serial_init(int uart_id);
 
 int serial_write(int uart_id, uint8_t *buffer, int size);
 
+int serial_write_motion(int uart_id, uint8_t *buffer, int size);
+
+bool serial_retract_motion(int uart_id);
+
+bool serial_tx_full(int uart_id);
+
 int serial_write_terminal(int uart_id, uint8_t *buffer, int size);
 
-bool serial_waitfor_tx(uint32_t max_wait_us);
+bool serial_waitfor_tx(int uart_id, uint32_t max_wait_us);
+
+void serial_set_data_bits(int uart_id, int data_bits);
+
+void serial_set_baud(int uart_id, uint32_t baud);
 
 int serial_read(int uart_id, uint8_t *buffer, int size);
 
-void serial_queue_pop(queue_t *queue, uint8_t *buffer);
+void serial_tx_init(uart_inst_t *uart);
+
+void serial_wake_init(int uart_id);
+
+void serial_wake_clear(int uart_id);
+
+bool serial_readable(int uart_id);
 
 int get_pins(int flag);
 
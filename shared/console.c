@@ -29,6 +29,7 @@
 #include "../pico/include/serial.h"
 #include "../pico/include/storage.h"
 #include "../pico/include/wrappers.h"
+#include "../pico/include/profile.h"
 #endif 
 
 #include "console.h"
@@ -45,15 +46,24 @@ R"#( __ _   _ __  ___ _  _ ___ ___
 / _` | | '  \/ _ \ || (_-</ -_)
 \__,_| |_|_|_\___/\_,_/__/\___=====_____)#";
 
+#ifdef AMOUSE_PROFILE
+#define HELP_MENU_PROFILE "9) Show profiling counters, 9 0 resets them\n"
+#else
+#define HELP_MENU_PROFILE ""
+#endif
+
 const char help_menu[] =
 R"#(1) Help/Usage
 2) Show current settings
 3) Set sensitivity (2-30)
-4) Set mouse protocol (0-2)
-   Proto(0:MS two-button 1: Logitech three-button 2: MS wheel)
+4) Set mouse protocol (0-3)
+   Proto(0:MS two-button 1: Logitech three-button 2: MS wheel 3: Mouse Systems)
 5) Swap left/right buttons.
 6) Read or write settings (Flash)
-0) Exit settings/Resume adapter
+7) Motion settings
+8) Short MS wheel packets when wheel is idle (0: off 1: on)
+   Faster updates, turn off if your driver expects 4 bytes
+)#" HELP_MENU_PROFILE R"#(0) Exit settings/Resume adapter
    eg. to set sensitivity to 11, enter: 3 11
 )#";
 
@@ -64,13 +74,27 @@ R"#(1) Help/Usage
 0) Return to main menu
 )#";
 
+const char help_menu_motion[] =
+R"#(1) Help/Usage
+2) Motion carry-over (0: off 1: on) [decay] [cap]
+   Decay(0: none 1: halve each packet 2: drop when stopped)
+   Cap(0-3: 256, 512, 1024 or 2048 counts of backlog)
+   eg. to carry motion with no decay and 1024 cap, enter: 2 1 0 2
+3) Acceleration curve (0: linear 1: power 2: custom, needs points from -A on Linux)
+0) Return to main menu
+)#";
+
+const char* carry_decay_names[] = { "none", "halve each packet", "drop when stopped" };
+const char* accel_curve_names[] = { "Linear", "Power", "Custom" };
+
 // Serial console menu contexts
-console_menu_t console_menu[3] =
+console_menu_t console_menu[4] =
 {
-  // Prompt     Help text        Help size                Parent context
-  { "exit",     "",              0,                       CONTEXT_EXIT_MENU }, // Dummy entry for exit
-  { "amouse",   help_menu,       sizeof(help_menu),       CONTEXT_EXIT_MENU }, // Main menu
-  { "flash",    help_menu_flash, sizeof(help_menu_flash), CONTEXT_MAIN_MENU }  // Flash menu
+  // Prompt     Help text         Help size                 Parent context
+  { "exit",     "",               0,                        CONTEXT_EXIT_MENU }, // Dummy entry for exit
+  { "amouse",   help_menu,        sizeof(help_menu),        CONTEXT_EXIT_MENU }, // Main menu
+  { "flash",    help_menu_flash,  sizeof(help_menu_flash),  CONTEXT_MAIN_MENU }, // Flash menu
+  { "motion",   help_menu_motion, sizeof(help_menu_motion), CONTEXT_MAIN_MENU }  // Motion menu
 };
 int console_context = CONTEXT_MAIN_MENU; // Default context
 
@@ -138,6 +162,18 @@ static void console_backspace(uint8_t cmd_buffer[], char* found_ptr, uint* write
   *write_pos = pwrite_pos;
 }
 
+static void console_print_carry(int fd, char* prefix) {
+  char itoa_buffer[6] = {0};
+
+  if(!g_mouse_options.motion_carry) {
+    console_printvar(fd, prefix, "Off", "\n");
+    return;
+  }
+  console_printvar(fd, prefix, "On, decay: ", (char*)carry_decay_names[g_mouse_options.carry_decay]);
+  itoa(CARRY_CAP_COUNTS(g_mouse_options.carry_cap), itoa_buffer, sizeof(itoa_buffer) - 1);
+  console_printvar(fd, ", cap: ", itoa_buffer, "\n");
+}
+
 static void console_menu_main(int fd, scan_int_t* scan_i) {
   char itoa_buffer[6] = {0}; // Re-usable buffer for converting ints to char arr
   scan_int_t scan_ii;
@@ -149,19 +185,25 @@ static void console_menu_main(int fd, scan_int_t* scan_i) {
     case 2: // Settings
       serial_write_terminal(fd, (uint8_t*)"[Settings]\n", 11);
       console_printvar(fd, "  Mouse protocol: ", g_mouse_protocol[g_mouse_options.protocol].name, "\n");
-      itoa((int)(g_mouse_options.sensitivity * 10), itoa_buffer, sizeof(itoa_buffer) - 1);
+      itoa(SENSITIVITY_TO_TENTHS(g_mouse_options.sensitivity), itoa_buffer, sizeof(itoa_buffer) - 1);
       console_printvar(fd, "  Mouse sensitivity: ", itoa_buffer, "\n");
       console_printvar(fd, "  Mouse buttons: ", (g_mouse_options.swap_buttons) ? "Swapped" : "Not swapped", "\n");
+      console_print_carry(fd, "  Motion carry-over: ");
+      console_printvar(fd, "  Wheel packets: ", (g_mouse_options.wheel_short) ? "3-4 bytes" : "4 bytes", "\n");
+      console_printvar(fd, "  Acceleration: ", (char*)accel_curve_names[g_mouse_options.accel_curve], "\n");
       break;
     case 3: // Sensitivity
       scan_ii = scan_int(cmd_buffer, scan_i->offset, CMD_BUFFER_LEN, 5);
       set_sensitivity(scan_ii);
-      itoa((int)(g_mouse_options.sensitivity * 10), itoa_buffer, sizeof(itoa_buffer) - 1);
+      itoa(SENSITIVITY_TO_TENTHS(g_mouse_options.sensitivity), itoa_buffer, sizeof(itoa_buffer) - 1);
       console_printvar(fd, "Mouse sensitivity set to ", itoa_buffer, ".\n");
       break;
     case 4: // Mouse protocol
       scan_ii = scan_int(cmd_buffer, scan_i->offset, CMD_BUFFER_LEN, 1);
-      if(scan_ii.found) { g_mouse_options.protocol = clampi(scan_ii.value, 0, 2); }
+      if(scan_ii.found) {
+        g_mouse_options.protocol = clampi(scan_ii.value, 0, g_mouse_protocol_num - 1);
+        apply_mouse_options();
+      }
       console_printvar(fd, "Mouse protocol set to ", g_mouse_protocol[g_mouse_options.protocol].name, ". You may want to re-initialize OS mouse driver.\n");
       break;
     case 5: // Swap left/right buttons
@@ -173,6 +215,22 @@ static void console_menu_main(int fd, scan_int_t* scan_i) {
     case 6: // Menu: Write/load flash
       console_new_context(fd, CONTEXT_FLASH_MENU);
       break;
+    case 7: // Menu: Motion settings
+      console_new_context(fd, CONTEXT_MOTION_MENU);
+      break;
+    case 8: // Short MS wheel packets
+      scan_ii = scan_int(cmd_buffer, scan_i->offset, CMD_BUFFER_LEN, 1);
+      if(scan_ii.found) { g_mouse_options.wheel_short = clampi(scan_ii.value, 0, 1); }
+      else { g_mouse_options.wheel_short = !g_mouse_options.wheel_short; }
+      console_printvar(fd, "MS wheel packets are now ", (g_mouse_options.wheel_short) ? "3-4 bytes" : "4 bytes", ".\n");
+      break;
+#ifdef AMOUSE_PROFILE
+    case 9: // Profiling counters
+      scan_ii = scan_int(cmd_buffer, scan_i->offset, CMD_BUFFER_LEN, 1);
+      if(scan_ii.found && scan_ii.value == 0) { profile_reset(); }
+      else { profile_print(fd); }
+      break;
+#endif
     case 0: // Exit
       console_new_context(fd, CONTEXT_EXIT_MENU);
       return;
@@ -189,6 +247,7 @@ static void console_menu_flash(int fd, scan_int_t* scan_i) {
       break;
     case 2: // Load binary settings from storage
       if(settings_decode(ptr_flash_settings(), &g_mouse_options)) {
+        apply_mouse_options();
         serial_write_terminal(fd, (uint8_t*)"Settings loaded.\n", 17);
       }
       else {
@@ -198,7 +257,7 @@ static void console_menu_flash(int fd, scan_int_t* scan_i) {
     case 3: // Write binary settings to storage
       settings_encode(&binary_settings[0], &g_mouse_options);
       serial_write_terminal(fd, (uint8_t*)"Writing settings.. ", 19);
-      serial_waitfor_tx(NS_FULL_SECOND);
+      serial_waitfor_tx(fd, U_FULL_SECOND);
       write_flash_settings(&binary_settings[0], sizeof(binary_settings));
       serial_write_terminal(fd, (uint8_t*)"Done\n", 5);
       break;
@@ -210,6 +269,54 @@ static void console_menu_flash(int fd, scan_int_t* scan_i) {
   }
 }
 
+static void console_menu_motion(int fd, scan_int_t* scan_i) {
+  scan_int_t scan_ii;
+
+  switch(scan_i->value) {
+    case 1: // Help
+      console_help(fd);
+      break;
+    case 2: // Motion carry-over, optionally followed by decay policy and cap
+      scan_ii = scan_int(cmd_buffer, scan_i->offset, CMD_BUFFER_LEN, 1);
+      if(scan_ii.found) { g_mouse_options.motion_carry = clampi(scan_ii.value, 0, 1); }
+      else { g_mouse_options.motion_carry = !g_mouse_options.motion_carry; }
+      scan_ii = scan_int(cmd_buffer, scan_ii.offset, CMD_BUFFER_LEN, 1);
+      if(scan_ii.found) { g_mouse_options.carry_decay = clampi(scan_ii.value, CARRY_DECAY_NONE, CARRY_DECAY_STOP); }
+      scan_ii = scan_int(cmd_buffer, scan_ii.offset, CMD_BUFFER_LEN, 1);
+      if(scan_ii.found) { g_mouse_options.carry_cap = clampi(scan_ii.value, 0, 3); }
+      console_print_carry(fd, "Motion carry-over: ");
+      break;
+    case 3: // Acceleration curve
+      scan_ii = scan_int(cmd_buffer, scan_i->offset, CMD_BUFFER_LEN, 1);
+      if(scan_ii.found) {
+        // Custom points can't be entered here or stored, don't pretend to have a curve without them.
+        if(scan_ii.value >= ACCEL_CUSTOM && g_mouse_options.accel_points_num == 0) {
+          serial_write_terminal(fd, (uint8_t*)"No custom points set, curve not changed.\n", 41);
+        }
+        else {
+          g_mouse_options.accel_curve = clampi(scan_ii.value, ACCEL_LINEAR, ACCEL_CUSTOM);
+          build_accel_lut();
+        }
+      }
+      console_printvar(fd, "Acceleration curve: ", (char*)accel_curve_names[g_mouse_options.accel_curve], "\n");
+      break;
+    case 0: // Back to parent menu
+      console_new_context(fd, console_menu[console_context].parent_menu);
+      return;
+    default:
+      serial_write_terminal(fd, (uint8_t*)"Command not valid.\n", 19);
+  }
+}
+
+// Check serial input for backspace used to open the console. Terminal is expected to be at 7N1, with 
+// 8N1 protocols the stop bit is received as the 8th data bit.
+bool console_requested(uint8_t *buffer, int size) {
+  for(int i=0; i < size; i++) {
+    if((buffer[i] & 0x7f) == '\b') { return true; }
+  }
+  return false;
+}
+
 // Serial console main
 void console(int fd) {
 
@@ -219,6 +326,7 @@ void console(int fd) {
   scan_int_t scan_i;
   
   memset(cmd_buffer, 0, CMD_BUFFER_LEN); // Clear command buffer if we get called multiple times.
+  serial_set_data_bits(fd, 7); // Console is always at 7N1
 
   serial_write_terminal(fd, (uint8_t*)g_amouse_title, sizeof(g_amouse_title));
   serial_write_terminal(fd, (uint8_t*)"\nv", 2);
@@ -291,6 +399,9 @@ void console(int fd) {
           case CONTEXT_FLASH_MENU:
             console_menu_flash(fd, &scan_i);
             break;
+          case CONTEXT_MOTION_MENU:
+            console_menu_motion(fd, &scan_i);
+            break;
           default:
             console_menu_main(fd, &scan_i);
         }
@@ -302,6 +413,7 @@ void console(int fd) {
       // Exit handling
       if(console_context == CONTEXT_EXIT_MENU) {
         serial_write_terminal(fd, (uint8_t*)amouse_bye, sizeof(amouse_bye));
+        serial_set_data_bits(fd, g_mouse_protocol[g_mouse_options.protocol].data_bits); // Protocol may have changed
         return;
       }
  
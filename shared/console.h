@@ -33,11 +33,14 @@ typedef struct console_menu {
 enum MENU_CONTEXT {
   CONTEXT_EXIT_MENU  = 0,
   CONTEXT_MAIN_MENU  = 1,
-  CONTEXT_FLASH_MENU = 2
+  CONTEXT_FLASH_MENU  = 2,
+  CONTEXT_MOTION_MENU = 3
 };
 
 /* Functions */
 
+bool console_requested(uint8_t *buffer, int size);
+
 void console(int fd);
 
 #endif // CONSOLE_H_
@@ -28,13 +28,66 @@
 #include "mouse.h"
 #include "utils.h"
 
+/*** Protocol encoders ***/
+
+// Microsoft base packet: sync bit, buttons and upper bits of motion in byte 0, lower 6 bits of motion in 1 and 2.
+static void encode_ms_base(const mouse_report_t *report, uint8_t *packet) {
+  packet[0] = 0x40 |
+              (report->lmb << MOUSE_LMB_BIT) |
+              (report->rmb << MOUSE_RMB_BIT) |
+              ((report->y & 0xc0) >> 4) |
+              ((report->x & 0xc0) >> 6);
+  packet[1] = report->x & 0x3f;
+  packet[2] = report->y & 0x3f;
+}
+
+static int encode_ms2button(const mouse_report_t *report, uint8_t *packet, int requested_len) {
+  (void)requested_len; // Fixed length packets
+  encode_ms_base(report, packet);
+  return(3);
+}
+
+// Logitech sends MMB in an optional 4th byte, on every MMB change (push_update on mmb change) and while held.
+static int encode_logitech(const mouse_report_t *report, uint8_t *packet, int requested_len) {
+  encode_ms_base(report, packet);
+  if(requested_len < 4 && !report->mmb) { return(3); }
+  packet[3] = (report->mmb) ? 0x20 : 0x00;
+  return(4);
+}
+
+// Optionally the 4th byte is left out while wheel and MMB are idle, like Logitech does with MMB.
+// Drivers that always expect 4 bytes would lose sync, hence a setting.
+static int encode_mswheel(const mouse_report_t *report, uint8_t *packet, int requested_len) {
+  encode_ms_base(report, packet);
+  if(g_mouse_options.wheel_short && requested_len < 4 && !report->mmb && report->wheel == 0) { return(3); }
+  // 4 bit two's complement, 15(negatives) when scrolling up, 1(positives) when scrolling down.
+  packet[3] = (report->mmb << MOUSE_MMB_BIT) | (-clampi(report->wheel, -15, 15) & 0x0f);
+  return(4);
+}
+
+// Mouse Systems: buttons active low, two signed 8 bit delta pairs per packet with Y pointing up.
+// Motion is split between the pairs, the host adds them up.
+static int encode_mousesys(const mouse_report_t *report, uint8_t *packet, int requested_len) {
+  (void)requested_len; // Fixed length packets
+  int x2 = report->x / 2;
+  int y2 = -report->y / 2;
+
+  packet[0] = 0x80 | (~((report->lmb << 2) | (report->mmb << 1) | report->rmb) & 0x07);
+  packet[1] = (uint8_t)(report->x - x2);
+  packet[2] = (uint8_t)(-report->y - y2);
+  packet[3] = (uint8_t)x2;
+  packet[4] = (uint8_t)y2;
+  return(5);
+}
+
 // Define available mouse protocols
-mouse_proto_t g_mouse_protocol[3] =
+mouse_proto_t g_mouse_protocol[4] =
 {
-// Name           Intro Len Btn Wheel  ReportLen
-  {"MS 2-button", "M",  1,  2,  false, 3}, // MS_2BUTTON = 0
-  {"Logitech",    "M3", 2,  3,  false, 3}, // LOGITECH   = 1, report is 3-4
-  {"MS wheeled",  "MZ", 2,  3,  true,  4}  // MS_WHEELED = 2
+// Name             Intro Len Btn Wheel  ReportLen Data Motion  Encoder
+  {"MS 2-button",   "M",  1,  2,  false, 3,        7,   127,    encode_ms2button}, // MS_2BUTTON = 0
+  {"Logitech",      "M3", 2,  3,  false, 3,        7,   127,    encode_logitech},  // LOGITECH   = 1, report is 3-4
+  {"MS wheeled",    "MZ", 2,  3,  true,  4,        7,   127,    encode_mswheel},   // MS_WHEELED = 2
+  {"Mouse Systems", "",   0,  3,  false, 5,        8,   2*127,  encode_mousesys}   // MOUSESYS   = 3, no ident
 };
 uint g_mouse_protocol_num = sizeof g_mouse_protocol / sizeof g_mouse_protocol[0];
 
@@ -46,70 +99,93 @@ uint8_t g_pkt_intellimouse_intro[] = {0x4D,0x5A,0x40,0x00,0x00,0x00,0x08,0x01,0x
                                     0x25,0x2c,0x12,0x16,0x09};
 int g_pkt_intellimouse_intro_len = 69;
 
-uint8_t init_mouse_state[] = "\x40\x00\x00\x00"; // Our basic mouse packet (We send 3 or 4 bytes of it)
-
 /*** Global data / BSS (Avoid stack) ***/ 
 
 mouse_opts_t g_mouse_options; // Global user settable options.
 
+static mouse_encoder_t mouse_encoder = encode_mswheel; // Encoder of selected protocol, see apply_mouse_options()
+static uint16_t accel_lut[ACCEL_LUT_SIZE]; // Acceleration gain per speed (Q8.8), see build_accel_lut()
+
 
 /*** Shared mouse functions ***/
 
+// Send as much of aggregated and carried motion as fits in a packet, keep the rest for following packets.
+static void carry_motion(mouse_state_t *mouse, int motion_max) {
+  int cap = CARRY_CAP_COUNTS(g_mouse_options.carry_cap);
+
+  // Hand has stopped, don't keep moving the cursor on the host.
+  if(g_mouse_options.carry_decay == CARRY_DECAY_STOP && mouse->x == 0 && mouse->y == 0) {
+    mouse->carry_x = mouse->carry_y = 0;
+  }
+
+  mouse->x += mouse->carry_x;
+  mouse->y += mouse->carry_y;
+  mouse->carry_x = mouse->x;
+  mouse->carry_y = mouse->y;
+  mouse->x = clampi(mouse->x, -motion_max, motion_max);
+  mouse->y = clampi(mouse->y, -motion_max, motion_max);
+  mouse->carry_x -= mouse->x;
+  mouse->carry_y -= mouse->y;
+
+  if(g_mouse_options.carry_decay == CARRY_DECAY_HALF) {
+    mouse->carry_x /= 2;
+    mouse->carry_y /= 2;
+  }
+  mouse->carry_x = clampi(mouse->carry_x, -cap, cap);
+  mouse->carry_y = clampi(mouse->carry_y, -cap, cap);
+}
+
 bool update_mouse_state(mouse_state_t *mouse) {
   if((mouse->update < 3) && (mouse->force_update == false)) { return(false); } // Minimum report size is 3 bytes.
-  int movement;
+  mouse_report_t report;
+  int motion_max = g_mouse_protocol[g_mouse_options.protocol].motion_max;
 
-  // Set mouse button states    
-  if(g_mouse_options.swap_buttons) {
-    mouse->state[0] |= (mouse->rmb << MOUSE_LMB_BIT);
-    mouse->state[0] |= (mouse->lmb << MOUSE_RMB_BIT);
-  }
+  // Clamp x, y inputs to values allowable by protocol.  
+  if(g_mouse_options.motion_carry) { carry_motion(mouse, motion_max); }
   else {
-    mouse->state[0] |= (mouse->lmb << MOUSE_LMB_BIT);
-    mouse->state[0] |= (mouse->rmb << MOUSE_RMB_BIT);
+    mouse->x = clampi(mouse->x, -motion_max, motion_max);
+    mouse->y = clampi(mouse->y, -motion_max, motion_max);
+    mouse->carry_x = mouse->carry_y = 0; // Carry-over may have been turned off with motion still carried
   }
 
-  // Clamp x, y, wheel inputs to values allowable by protocol.  
-  mouse->x = clampi(mouse->x, -127, 127);
-  mouse->y = clampi(mouse->y, -127, 127);
-
-  // Update aggregated mouse movement state
-  movement = mouse->x & 0xc0; // Get 2 upper bits of X movement
-  mouse->state[0] = mouse->state[0] | (movement >> 6); // Set packet bits, 8th bit to 2nd bit (Discards bits)
-  mouse->state[1] = mouse->state[1] | (mouse->x & 0x3f);
-
-  movement = mouse->y & 0xc0; // Get 2 upper bits of Y movement
-  mouse->state[0] = mouse->state[0] | (movement >> 4);
-  mouse->state[2] = mouse->state[2] | (mouse->y & 0x3f);
-
-  // Protocol specific handling
-  switch(g_mouse_options.protocol) {
-    case PROTO_LOGITECH: 
-      if(mouse->mmb) {
-	      mouse->state[3] = 0x20;
-      }
-      // Note: Implicit, MMB release gets also sent as 4 byte packet (push_update on mmb change).
-      break;
-    case PROTO_MSWHEEL: 
-      mouse->wheel = clampi(mouse->wheel, -15, 15);
-      mouse->state[3] |= (mouse->mmb << MOUSE_MMB_BIT);
-      mouse->state[3] = mouse->state[3] | (-mouse->wheel & 0x0f); // 127(negatives) when scrolling up, 1(positives) when scrolling down.
-      mouse->update = g_mouse_protocol[g_mouse_options.protocol].report_len;
-      break;
-    default:
-      // Get protocol default report length
-      mouse->update = g_mouse_protocol[g_mouse_options.protocol].report_len;
-  }
+  report.x     = mouse->x;
+  report.y     = mouse->y;
+  report.wheel = mouse->wheel;
+  report.lmb   = (g_mouse_options.swap_buttons) ? mouse->rmb : mouse->lmb;
+  report.rmb   = (g_mouse_options.swap_buttons) ? mouse->lmb : mouse->rmb;
+  report.mmb   = mouse->mmb;
 
+  mouse->update = mouse_encoder(&report, mouse->state, mouse->update);
   return(true);
 }
 
 void reset_mouse_state(mouse_state_t *mouse) {
-  memcpy( mouse->state, init_mouse_state, sizeof(mouse->state) ); // Set packet memory to initial state
   mouse->update = -1;
   mouse->force_update = 0;
   mouse->x = mouse->y = mouse->wheel = 0;
   // Do not reset button states here, will be updated on release of buttons.
+
+  // Carried motion still needs to go out, request another packet for it.
+  if(mouse->carry_x || mouse->carry_y) { push_update(mouse, mouse->mmb); }
+}
+
+// Driver (re)initialized, drop motion it never asked for: aggregated deltas, carry-over and 
+// sensitivity remainders. Button states are kept, they still reflect the real buttons.
+void reset_motion_backlog(mouse_state_t *mouse) {
+  mouse->carry_x = mouse->carry_y = 0;
+  mouse->x_frac = mouse->y_frac = 0;
+  reset_mouse_state(mouse);
+}
+
+// Apply options that need preparation before use, call whenever protocol or acceleration settings change.
+void apply_mouse_options(void) {
+  g_mouse_options.protocol = clampi(g_mouse_options.protocol, 0, g_mouse_protocol_num - 1);
+  mouse_encoder = g_mouse_protocol[g_mouse_options.protocol].encode;
+  // Points aren't stored with settings, a custom curve loaded without them is really linear.
+  if(g_mouse_options.accel_curve == ACCEL_CUSTOM && g_mouse_options.accel_points_num == 0) {
+    g_mouse_options.accel_curve = ACCEL_LINEAR;
+  }
+  build_accel_lut();
 }
 
 // Changing settings based on user input
@@ -119,9 +195,10 @@ void runtime_settings(mouse_state_t *mouse) {
   if(mouse->lmb && mouse->rmb) {
     // Handle sensitivity changes
     if(mouse->wheel != 0) {
-      if(mouse->wheel < 0) { g_mouse_options.sensitivity -= 0.2; }
-      else { g_mouse_options.sensitivity += 0.2; }
-      g_mouse_options.sensitivity = clampf(g_mouse_options.sensitivity, 0.2, 3.0);
+      int steps = SENSITIVITY_TO_STEPS(g_mouse_options.sensitivity);
+      if(mouse->wheel < 0) { steps--; }
+      else { steps++; }
+      g_mouse_options.sensitivity = SENSITIVITY_FROM_STEPS(clampi(steps, 1, 15));
     }
 
     if(mouse->mmb) {
@@ -130,17 +207,124 @@ void runtime_settings(mouse_state_t *mouse) {
   }
 }
 
-// Adjust mouse input based on sensitivity
+// Gain of a user defined curve at speed, interpolated between the surrounding points.
+static uint16_t accel_custom_gain(int speed) {
+  accel_point_t *points = g_mouse_options.accel_points;
+  int num = clampi(g_mouse_options.accel_points_num, 0, ACCEL_POINTS_MAX);
+  int i;
+
+  if(num == 0) { return(SENSITIVITY_ONE); }
+  if(speed <= points[0].speed) { return(points[0].gain); }
+
+  for(i=1; i < num && speed > points[i].speed; i++);
+  if(i == num) { return(points[num - 1].gain); }
+
+  int span = points[i].speed - points[i - 1].speed;
+  if(span <= 0) { return(points[i].gain); }
+  return(points[i - 1].gain + ((points[i].gain - points[i - 1].gain) * (speed - points[i - 1].speed)) / span);
+}
+
+// Compile selected acceleration curve into the lookup table. Call whenever acceleration settings change,
+// packets only do a table lookup.
+void build_accel_lut(void) {
+  int gain;
+
+  for(int speed=0; speed < ACCEL_LUT_SIZE; speed++) {
+    switch(g_mouse_options.accel_curve) {
+      case ACCEL_POWER:
+        gain = SENSITIVITY_ONE + (speed * speed * SENSITIVITY_ONE) / (ACCEL_POWER_KNEE * ACCEL_POWER_KNEE);
+        break;
+      case ACCEL_CUSTOM:
+        gain = accel_custom_gain(speed);
+        break;
+      default:
+        gain = SENSITIVITY_ONE;
+    }
+    accel_lut[speed] = clampi(gain, 0, ACCEL_GAIN_MAX);
+  }
+}
+
+// Adjust mouse input based on sensitivity and acceleration, integer only to avoid soft-float on the Pico.
+// Fraction of a count left after scaling is kept for the next packet, so slow movements add up instead of 
+// getting truncated to zero. Division truncates toward zero, treating both directions the same.
 void input_sensitivity(mouse_state_t *mouse) {
-  mouse->x = mouse->x * g_mouse_options.sensitivity;
-  mouse->y = mouse->y * g_mouse_options.sensitivity;
+  int scaled;
+  int gain = g_mouse_options.sensitivity;
+
+  if(g_mouse_options.accel_curve != ACCEL_LINEAR) {
+    // Octagonal approximation of vector length, close enough to pick a gain.
+    int ax = (mouse->x < 0) ? -mouse->x : mouse->x;
+    int ay = (mouse->y < 0) ? -mouse->y : mouse->y;
+    int speed = (ax > ay) ? ax + ay / 2 : ay + ax / 2;
+    gain = (gain * accel_lut[clampi(speed, 0, ACCEL_LUT_SIZE - 1)]) / SENSITIVITY_ONE;
+  }
+
+  scaled = mouse->x * gain + mouse->x_frac;
+  mouse->x = scaled / SENSITIVITY_ONE;
+  mouse->x_frac = scaled - mouse->x * SENSITIVITY_ONE;
+
+  scaled = mouse->y * gain + mouse->y_frac;
+  mouse->y = scaled / SENSITIVITY_ONE;
+  mouse->y_frac = scaled - mouse->y * SENSITIVITY_ONE;
 }
 
 // Helper function for keeping mouse sensitivity setting consistent.
 void set_sensitivity(scan_int_t scan_i) {
   if(scan_i.found) {
-    g_mouse_options.sensitivity = clampf(((float)scan_i.value / 10), 0.2, 3.0);
+    g_mouse_options.sensitivity = clampi(SENSITIVITY_FROM_TENTHS(scan_i.value), SENSITIVITY_MIN, SENSITIVITY_MAX);
+  }
+}
+
+/*** Line rate handling ***/
+
+// Line settings a mouse comes up with, also restored whenever the driver initializes the mouse.
+void reset_line_state(mouse_state_t *mouse) {
+  mouse->baud = MOUSE_BAUD_DEFAULT;
+  mouse->report_rate = 0;
+  mouse->logitech_prefix = false;
+}
+
+// Parse a byte of Logitech host commands (XFree86 mapping), returns which setting changed.
+// Caller is responsible for reconfiguring the serial port on LOGI_CMD_BAUD.
+int logitech_command(mouse_state_t *mouse, uint8_t cmd) {
+  cmd &= 0x7f; // Host may be sending at 7N1 or 8N1
+
+  if(mouse->logitech_prefix) {
+    mouse->logitech_prefix = false;
+    switch(cmd) {
+      case 'n': mouse->baud = 1200; break;
+      case 'o': mouse->baud = 2400; break;
+      case 'p': mouse->baud = 4800; break;
+      case 'q': mouse->baud = 9600; break;
+      default: return(LOGI_CMD_NONE);
+    }
+    return(LOGI_CMD_BAUD);
+  }
+
+  switch(cmd) {
+    case '*': mouse->logitech_prefix = true; return(LOGI_CMD_NONE);
+    case 'J': mouse->report_rate = 10;  break;
+    case 'K': mouse->report_rate = 20;  break;
+    case 'L': mouse->report_rate = 35;  break;
+    case 'R': mouse->report_rate = 50;  break;
+    case 'M': mouse->report_rate = 70;  break;
+    case 'Q': mouse->report_rate = 100; break;
+    case 'N': mouse->report_rate = 150; break;
+    case 'O': mouse->report_rate = 0;   break; // Continuous, as fast as the line allows
+    default: return(LOGI_CMD_NONE);
+  }
+  return(LOGI_CMD_RATE);
+}
+
+// Time to reserve for a packet: its line time, but no shorter than the report rate selected by 
+// the driver. Units follow full_second (us on Pico, ns on Linux).
+uint64_t packet_interval(const mouse_state_t *mouse, uint64_t airtime, uint64_t full_second) {
+  uint64_t interval = airtime;
+
+  if(mouse->report_rate > 0 && interval < full_second / mouse->report_rate) {
+    interval = full_second / mouse->report_rate;
   }
+  return(interval);
 }
 
 /*** Flow control functions ***/
@@ -26,7 +26,7 @@
 
 extern mouse_opts_t g_mouse_options; // Global options
 
-extern mouse_proto_t g_mouse_protocol[3]; // Global options
+extern mouse_proto_t g_mouse_protocol[4]; // Global options
 extern uint g_mouse_protocol_num;
 
 extern uint8_t g_pkt_intellimouse_intro[];
@@ -38,8 +38,20 @@ bool update_mouse_state(mouse_state_t *mouse);
 
 void reset_mouse_state(mouse_state_t *mouse);
 
+void reset_motion_backlog(mouse_state_t *mouse);
+
+void apply_mouse_options(void);
+
 void runtime_settings(mouse_state_t *mouse);
 
+void reset_line_state(mouse_state_t *mouse);
+
+int logitech_command(mouse_state_t *mouse, uint8_t cmd);
+
+uint64_t packet_interval(const mouse_state_t *mouse, uint64_t airtime, uint64_t full_second);
+
+void build_accel_lut(void);
+
 void input_sensitivity(mouse_state_t *mouse);
 
 void set_sensitivity(scan_int_t scan_i);
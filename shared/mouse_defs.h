@@ -21,52 +21,116 @@
 #define MOUSE_LMB_BIT 5 // Defines << shift for bit position
 #define MOUSE_RMB_BIT 4
 #define MOUSE_MMB_BIT 4 // Shift 4 times in 4th byte
+#define MOUSE_PACKET_MAX 5 // Longest packet of any protocol
+
+// Motion and buttons going into a single packet, clamped to packet limits
+typedef struct mouse_report {
+  int x, y, wheel;
+  bool lmb, rmb, mmb;
+} mouse_report_t;
+
+// Protocol packet encoder, writes a complete packet and returns its length.
+// Requested length is what input handling asked for (3 or 4), protocols with fixed size may ignore it.
+typedef int (*mouse_encoder_t)(const mouse_report_t *report, uint8_t *packet, int requested_len);
 
 typedef struct mouse_proto {
-  char    name[12];
+  char    name[16];
   uint8_t serial_ident[2]; // M, M3, MZ..
   int     serial_ident_len;
   int     buttons;
   bool    wheel;
   int     report_len;
+  int     data_bits;  // Serial line format, 7N1 or 8N1
+  int     motion_max; // Largest delta per axis in a packet
+  mouse_encoder_t encode;
 } mouse_proto_t;
 
 enum MOUSE_PROTOCOLS {
   PROTO_MS2BUTTON = 0, // 2 buttons, 3 bytes
   PROTO_LOGITECH  = 1, // 3 buttons, 3-4 bytes
   PROTO_MSWHEEL   = 2, // 3 buttons, wheel, 4 bytes.
-  PROTO_MOUSESYS  = 3  // Mouse systems, TBD
+  PROTO_MOUSESYS  = 3  // 3 buttons, 5 bytes at 8N1, two deltas per packet
+};
+
+// Time units, see serial_line_t for line timing
+#define U_FULL_SECOND  1000000L    // 1s in microseconds
+#define NS_FULL_SECOND 1000000000L // 1s in nanoseconds
+
+// Logitech host commands, '*' followed by n/o/p/q selects baud, single letters select report rate.
+#define MOUSE_BAUD_DEFAULT 1200 // Line rate after power on or driver re-init
+
+enum LOGITECH_COMMANDS {
+  LOGI_CMD_NONE = 0, // Not a command or incomplete
+  LOGI_CMD_BAUD = 1, // Line rate changed, serial port needs reconfiguring
+  LOGI_CMD_RATE = 2  // Report rate changed
 };
 
-// Delay between data packets for 1200 baud
-#define U_FULL_SECOND 1000000L      // 1s in microseconds
-#define U_SERIALDELAY_1B  7500      // 1 byte
-#define U_SERIALDELAY_3B  22700     // 3 bytes (microseconds)
-#define U_SERIALDELAY_4B  30000     // 4 bytes (microseconds)
-// 1200 baud (bits/s) is 133.333333333... bytes/s
-// 44.44.. updates per second with 3 bytes.
-// 33.25.. updates per second with 4 bytes.
-// ~0.0075 seconds per byte, target time calculated for 4 bytes.
-#define NS_FULL_SECOND    1000000000L // 1s in nanoseconds
-#define NS_SERIALDELAY_1B   7500000   // 1 byte
-#define NS_SERIALDELAY_3B   22700000  // 3 bytes
-#define NS_SERIALDELAY_4B   30000000  // 4 bytes
+// Motion carry-over, excess motion over packet limits is sent in following packets
+#define MOUSE_MOTION_MAX 127 // Largest delta per axis in a packet (Microsoft), see mouse_proto_t
+#define CARRY_CAP_COUNTS(cap) (256 << (cap)) // Backlog cap setting (0-3) to counts per axis
+
+enum CARRY_DECAY {
+  CARRY_DECAY_NONE = 0, // Keep backlog until it has been sent
+  CARRY_DECAY_HALF = 1, // Halve backlog each packet, long flicks fade out
+  CARRY_DECAY_STOP = 2  // Drop backlog once input stops
+};
+
+// Pointer acceleration, gain (Q8.8) is looked up by per packet speed from a table that is built
+// when settings change. Speed is in input counts per packet before sensitivity scaling.
+#define ACCEL_LUT_SIZE   128 // Speeds covered by the table, faster movement uses the last entry
+#define ACCEL_POWER_KNEE 32  // Speed where the power curve reaches a gain of 2.0
+#define ACCEL_POINTS_MAX 8   // User defined curve points
+
+enum ACCEL_CURVES {
+  ACCEL_LINEAR = 0, // Constant gain of 1.0, sensitivity only
+  ACCEL_POWER  = 1, // Gain of 1 + (speed / knee)^2
+  ACCEL_CUSTOM = 2  // Linear interpolation between user defined points
+};
+
+typedef struct accel_point {
+  uint8_t  speed; // Counts per packet
+  uint16_t gain;  // Q8.8 fixed point
+} accel_point_t;
+
+// Sensitivity is kept in Q8.8 fixed point, RP2040 has no FPU.
+// User facing values are in steps of 0.2 (1-15) or tenths (2-30).
+#define SENSITIVITY_ONE    256 // 1.0
+#define SENSITIVITY_STEPS  5   // Steps of 0.2 per 1.0
+#define SENSITIVITY_FROM_STEPS(steps) (((steps) * SENSITIVITY_ONE) / SENSITIVITY_STEPS)
+#define SENSITIVITY_TO_STEPS(sens)    ((((sens) * SENSITIVITY_STEPS) + (SENSITIVITY_ONE / 2)) / SENSITIVITY_ONE)
+#define SENSITIVITY_FROM_TENTHS(tenths) (((tenths) * SENSITIVITY_ONE) / 10)
+#define SENSITIVITY_TO_TENTHS(sens)   ((((sens) * 10) + (SENSITIVITY_ONE / 2)) / SENSITIVITY_ONE)
+#define SENSITIVITY_MIN    SENSITIVITY_FROM_STEPS(1)  // 0.2
+#define SENSITIVITY_MAX    SENSITIVITY_FROM_STEPS(15) // 3.0
+#define ACCEL_GAIN_MAX     (4 * SENSITIVITY_ONE)      // 4.0
 
 // Struct for storing information about accumulated mouse state
 typedef struct mouse_state {
   int pc_state; // Current state of mouse driver initialization on PC.
-  uint8_t state[4]; // Mouse state
+  uint8_t state[MOUSE_PACKET_MAX]; // Encoded packet
   int x, y, wheel;
+  int x_frac, y_frac; // Sub-count remainders from sensitivity scaling, carried between packets (Q8.8)
+  int carry_x, carry_y; // Motion over packet limits waiting for following packets
   int update; // How many bytes to send
   bool lmb, rmb, mmb, force_update;
+  uint32_t baud;        // Current line rate, Logitech drivers may change it
+  uint16_t report_rate; // Reports per second limit from Logitech driver, 0 for unlimited
+  bool logitech_prefix; // '*' received, next byte selects baud
 } mouse_state_t;
 
 // Struct for user settable mouse options
 typedef struct mouse_opts {
   uint protocol;
-  float sensitivity; // Sensitivity coefficient
+  uint16_t sensitivity; // Sensitivity coefficient, Q8.8 fixed point (SENSITIVITY_ONE == 1.0)
   bool wheel;
   bool swap_buttons;
+  bool wheel_short;    // MS wheel: send 3 byte packets while wheel and MMB are idle, needs driver support
+  bool motion_carry;   // Carry motion over packet limits to following packets instead of discarding it
+  uint8_t carry_decay; // CARRY_DECAY_* policy for carried motion
+  uint8_t carry_cap;   // Max backlog per axis, see CARRY_CAP_COUNTS()
+  uint8_t accel_curve; // ACCEL_* curve, see build_accel_lut()
+  uint8_t accel_points_num; // Points in use for ACCEL_CUSTOM, sorted by speed. Not persisted.
+  accel_point_t accel_points[ACCEL_POINTS_MAX];
 } mouse_opts_t;
 
 // States of mouse init request from PC
@@ -0,0 +1,99 @@
+/*
+ * Anachro Mouse, a usb to serial mouse adaptor. Copyright (C) 2025 Aviancer <oss+amouse@skyvian.me>
+ *
+ * This library is free software; you can redistribute it and/or modify it under the terms of the 
+ * GNU Lesser General Public License as published by the Free Software Foundation; either version 
+ * 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without 
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the 
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with this library; 
+ * if not, write to the Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+*/
+
+/* pacing.c: Architecture independent transmit scheduling */
+
+#include "pacing.h"
+
+    /*
+     *  Each packet deadline is computed from the previous deadline rather than from the time 
+     *  the write returned. Loop and write latency then does not add up over packets, so the 
+     *  long-run packet rate matches what the line can carry.
+     *
+     *  Being late by up to the error budget is carried on the timeline, the next packet just 
+     *  follows the previous one sooner. Beyond that the line has been idle and the timeline 
+     *  restarts from current time, so we don't burst out packets to catch up.
+     *
+     *  A packet sent before its deadline (button changes) queues behind the previous one, 
+     *  the line is busy until deadline + airtime.
+    */
+
+    /*
+     *  Line time of a byte is its frame bits over baud, eg. 9 bits at 7N1 1200 baud is exactly 7.5ms 
+     *  but 10 bits at 8N1 is 8.333..ms. Packet airtime keeps the remainder of the division for the 
+     *  next packet, so the timeline stays exact over any number of packets in either time unit.
+    */
+
+void line_init(serial_line_t *line, uint64_t full_second, uint32_t baud, int data_bits, int parity_bits, int stop_bits) {
+  line->full_second = full_second;
+  line->baud = 0;
+  line_set_baud(line, baud);
+  line_set_format(line, data_bits, parity_bits, stop_bits);
+}
+
+void line_set_baud(serial_line_t *line, uint32_t baud) {
+  if(baud == 0 || baud == line->baud) { return; }
+  line->baud = baud;
+  line->remainder = 0; // Remainder is in units of the old baud
+}
+
+void line_set_format(serial_line_t *line, int data_bits, int parity_bits, int stop_bits) {
+  line->frame_bits = 1 + data_bits + parity_bits + stop_bits; // Start bit is always there
+}
+
+// Time for bytes to go out on the line, rounded up. For waits and estimates.
+uint64_t line_time(const serial_line_t *line, int bytes) {
+  uint64_t bit_time = (uint64_t)bytes * line->frame_bits * line->full_second;
+  return((bit_time + line->baud - 1) / line->baud);
+}
+
+// Exact airtime of a packet, fraction of a time unit is carried over to the next packet.
+uint64_t line_airtime(serial_line_t *line, int bytes) {
+  uint64_t bit_time = (uint64_t)bytes * line->frame_bits * line->full_second + line->remainder;
+  line->remainder = bit_time % line->baud;
+  return(bit_time / line->baud);
+}
+
+void tx_schedule_init(tx_schedule_t *sched, uint64_t now, uint64_t budget) {
+  sched->deadline = now;
+  sched->budget = budget;
+}
+
+bool tx_schedule_due(tx_schedule_t *sched, uint64_t now) {
+  return(now >= sched->deadline);
+}
+
+// Account for a packet taking airtime on the line, written at time now.
+void tx_schedule_advance(tx_schedule_t *sched, uint64_t now, uint64_t airtime) {
+  if(now > sched->deadline + sched->budget) { sched->deadline = now; }
+  sched->deadline += airtime;
+}
+
+// Line is known to be busy for delay from now, push deadline out.
+void tx_schedule_defer(tx_schedule_t *sched, uint64_t now, uint64_t delay) {
+  sched->deadline = now + delay;
+}
+
+// Budget for lagging behind the timeline is one byte time on the line. Call whenever line rate or
+// format changes, a budget left over from 1200 baud would allow bursts of packets at 9600.
+void tx_schedule_follow_line(tx_schedule_t *sched, const serial_line_t *line) {
+  sched->budget = line_time(line, 1);
+}
+
+// Packet was taken back before it went out, return its airtime to the timeline.
+void tx_schedule_rewind(tx_schedule_t *sched, uint64_t airtime) {
+  sched->deadline = (sched->deadline > airtime) ? sched->deadline - airtime : 0;
+}
@@ -0,0 +1,62 @@
+/*
+ * Anachro Mouse, a usb to serial mouse adaptor. Copyright (C) 2025 Aviancer <oss+amouse@skyvian.me>
+ *
+ * This library is free software; you can redistribute it and/or modify it under the terms of the 
+ * GNU Lesser General Public License as published by the Free Software Foundation; either version 
+ * 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without 
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the 
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with this library; 
+ * if not, write to the Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+*/
+
+#ifndef PACING_H_
+#define PACING_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Transmit schedule kept on an absolute timeline. Time units are up to the caller, 
+// Linux uses nanoseconds (CLOCK_MONOTONIC) and Pico microseconds (time_us_64).
+typedef struct tx_schedule {
+  uint64_t deadline; // Absolute time when the line is free for the next packet
+  uint64_t budget;   // How late we may be on the timeline before re-anchoring to current time
+} tx_schedule_t;
+
+// Serial line frame format, for computing how long bytes take to transmit.
+typedef struct serial_line {
+  uint64_t full_second; // Time units per second, same units as the transmit schedule
+  uint32_t baud;
+  uint8_t  frame_bits;  // Start, data, parity and stop bits of a byte
+  uint64_t remainder;   // Time left over from previous packets below one unit, in 1/baud units
+} serial_line_t;
+
+/* Functions */
+
+void line_init(serial_line_t *line, uint64_t full_second, uint32_t baud, int data_bits, int parity_bits, int stop_bits);
+
+void line_set_baud(serial_line_t *line, uint32_t baud);
+
+void line_set_format(serial_line_t *line, int data_bits, int parity_bits, int stop_bits);
+
+uint64_t line_time(const serial_line_t *line, int bytes);
+
+uint64_t line_airtime(serial_line_t *line, int bytes);
+
+void tx_schedule_init(tx_schedule_t *sched, uint64_t now, uint64_t budget);
+
+bool tx_schedule_due(tx_schedule_t *sched, uint64_t now);
+
+void tx_schedule_advance(tx_schedule_t *sched, uint64_t now, uint64_t airtime);
+
+void tx_schedule_defer(tx_schedule_t *sched, uint64_t now, uint64_t delay);
+
+void tx_schedule_rewind(tx_schedule_t *sched, uint64_t airtime);
+
+void tx_schedule_follow_line(tx_schedule_t *sched, const serial_line_t *line);
+
+#endif // PACING_H_
@@ -45,12 +45,17 @@
      *  
      *    Sensitivity is between 0.2 and 3.0 with increments/decrements of 0.2.
      *    Effectively 16 values -> 4 bits for 16 values. We convert sensitivity
-     *    from float to integer multiplq 0.2 for storing in bit field.
+     *    from Q8.8 fixed point to integer multiple of 0.2 for storing in bit field.
      *
      *    Flags: (0x06) WHEEL, (0x07) SWAP_BUTTONS
      *
-     *  |               RESERVED|FLAGS|SENSITIVITY|PROTO|
-     *  |15 14 13 12 11 10 09 08|07 06|05 04 03 02|01 00|
+     *    Options 2: Motion carry-over flag (0x08), decay policy (2 bits) and 
+     *    backlog cap (2 bits). All zero is carry-over disabled, as in older settings.
+     *    Acceleration curve (2 bits), custom curve points are not stored.
+     *    Short MS wheel packets flag (0x0F).
+     *
+     *  |SHORT|ACCEL|  CAP|DECAY|CARRY|FLAGS|SENSITIVITY|PROTO|
+     *  |   15|14 13|12 11|10 09|   08|07 06|05 04 03 02|01 00|
      *
     */
 
@@ -74,7 +79,6 @@ bool settings_decode(uint8_t *binary_settings, mouse_opts_t *options) {
     state &= assert_byte(SETTINGS_VERSION, binary_settings[2]);
     uint8_t settings1 = binary_settings[FLASH_OPT1_BYTE];
     uint8_t settings2 = binary_settings[FLASH_OPT2_BYTE];
-    (void) settings2; // Unused, reserved. Silences warning.
     state &= assert_byte(0x75, binary_settings[5]);
     state &= assert_byte(0x53, binary_settings[6]);
 
@@ -83,10 +87,16 @@ bool settings_decode(uint8_t *binary_settings, mouse_opts_t *options) {
     uint8_t sens;
     options->protocol = clampi(settings1 & 0x03, 0, 3);        // 0x03 == 0b11
     sens = (settings1 >> 2) & 0x0F;                            // Shifting right to get rid of proto, 0x0F == 0b1111
-    options->sensitivity  = clampf(sens * 0.2, 0.2, 3.0);
+    options->sensitivity  = SENSITIVITY_FROM_STEPS(clampi(sens, 1, 15));
     options->wheel        = (bool)(settings1 >> 6) & 0x01;    // Shifting right to get rid of proto and sensitivity, 0x01 is a bool
     options->swap_buttons = (bool)(settings1 >> 7) & 0x01;    // Shifting right to get rid of proto, sensitivity, and the first flag, 0x01 is a bool 
 
+    options->motion_carry = (bool)(settings2 & 0x01);
+    options->carry_decay  = clampi((settings2 >> 1) & 0x03, CARRY_DECAY_NONE, CARRY_DECAY_STOP);
+    options->carry_cap    = (settings2 >> 3) & 0x03;
+    options->accel_curve  = clampi((settings2 >> 5) & 0x03, ACCEL_LINEAR, ACCEL_CUSTOM);
+    options->wheel_short  = (bool)(settings2 >> 7) & 0x01;
+
     return state;
 }
 
@@ -96,7 +106,7 @@ void settings_encode(uint8_t *binary_settings, mouse_opts_t *options) {
     binary_settings[1] = 0x6F;             // 01: Canary o
     binary_settings[2] = SETTINGS_VERSION; // 02: Config version 0x00
     binary_settings[3] = 0x00;             // 03: Options 1
-    binary_settings[4] = 0x00;             // 04: Options 2 (Reserved)
+    binary_settings[4] = 0x00;             // 04: Options 2
     binary_settings[5] = 0x75;             // 05: Canary u
     binary_settings[6] = 0x53;             // 06: Canary S
     binary_settings[7] = 0x00;             // 07: CRC-8 Checksum
@@ -104,14 +114,21 @@ void settings_encode(uint8_t *binary_settings, mouse_opts_t *options) {
     // Writing options
     // Convert mouse options struct into bitfield that can be written to flash
  
-    // Approximal conversion from float to 0.2 multiplier
-    uint8_t sensitivity = clampi((int)(options->sensitivity / 0.2), 1, 15);
+    // Conversion from fixed point to 0.2 multiplier, rounded to nearest step
+    uint8_t sensitivity = clampi(SENSITIVITY_TO_STEPS(options->sensitivity), 1, 15);
  
     binary_settings[FLASH_OPT1_BYTE] = 
        ((options->protocol    & 0x03) | 
        (sensitivity           & 0x0F) << 2 | 
        (options->wheel        & 0x01) << 6 |
        (options->swap_buttons & 0x01) << 7);
+
+    binary_settings[FLASH_OPT2_BYTE] =
+       ((options->motion_carry & 0x01) |
+       (options->carry_decay   & 0x03) << 1 |
+       (options->carry_cap     & 0x03) << 3 |
+       (options->accel_curve   & 0x03) << 5 |
+       (options->wheel_short   & 0x01) << 7);
  
     // Calculate CRC of configuration data and store it alongside it
     binary_settings[FLASH_CRC_BYTE] = crc8(&binary_settings[0], 7, (uint8_t)0x00);
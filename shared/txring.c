@@ -0,0 +1,84 @@
+/*
+ * Anachro Mouse, a usb to serial mouse adaptor. Copyright (C) 2025 Aviancer <oss+amouse@skyvian.me>
+ *
+ * This library is free software; you can redistribute it and/or modify it under the terms of the 
+ * GNU Lesser General Public License as published by the Free Software Foundation; either version 
+ * 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without 
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the 
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with this library; 
+ * if not, write to the Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+*/
+
+
+/* txring.c: Lock-free hand-off of serial output between a producer and a consumer, cores or interrupts */
+
+#include <string.h>
+
+#include "txring.h"
+
+    /*
+     *  Producer fills the chunk at head and then publishes it with a release store of head, 
+     *  consumer reads head with acquire before touching the chunk. Same in reverse for tail,
+     *  a chunk slot is only reused once the consumer has released it. On the RP2040 these are 
+     *  plain word loads and stores with a memory barrier, no spinlocks involved.
+    */
+
+void tx_ring_init(tx_ring_t *ring) {
+  ring->head = 0;
+  ring->tail = 0;
+}
+
+uint32_t tx_ring_level(tx_ring_t *ring) {
+  return(__atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE));
+}
+
+bool tx_ring_empty(tx_ring_t *ring) {
+  return(tx_ring_level(ring) == 0);
+}
+
+/*** Producer side ***/
+
+// Slot for the next chunk, or NULL if the ring is full. Not visible to consumer until published.
+tx_chunk_t* tx_ring_claim(tx_ring_t *ring) {
+  uint32_t head = ring->head;
+  if(head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) >= TX_RING_SIZE) { return(NULL); }
+  return(&ring->chunks[head & (TX_RING_SIZE - 1)]);
+}
+
+// Hand the claimed chunk with len bytes of data to the consumer.
+void tx_ring_publish(tx_ring_t *ring, int len, int type) {
+  tx_chunk_t *chunk = &ring->chunks[ring->head & (TX_RING_SIZE - 1)];
+  chunk->len = (len > TX_CHUNK_MAX) ? TX_CHUNK_MAX : len;
+  chunk->type = type;
+  __atomic_store_n(&ring->head, ring->head + 1, __ATOMIC_RELEASE);
+}
+
+// Take back the newest chunk if it is of type and still waiting behind an unreleased one, so the 
+// consumer can't have started on it. Consumer must not release meanwhile, on the Pico the consumer 
+// is the DMA interrupt so this is called with interrupts disabled.
+bool tx_ring_retract(tx_ring_t *ring, int type) {
+  uint32_t head = ring->head;
+  if(head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) < 2) { return(false); }
+  if(ring->chunks[(head - 1) & (TX_RING_SIZE - 1)].type != type) { return(false); }
+
+  __atomic_store_n(&ring->head, head - 1, __ATOMIC_RELEASE);
+  return(true);
+}
+
+/*** Consumer side ***/
+
+// Oldest published chunk, or NULL if the ring is empty. Stays valid until released.
+tx_chunk_t const* tx_ring_peek(tx_ring_t *ring) {
+  uint32_t tail = ring->tail;
+  if(__atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) == tail) { return(NULL); }
+  return(&ring->chunks[tail & (TX_RING_SIZE - 1)]);
+}
+
+void tx_ring_release(tx_ring_t *ring) {
+  __atomic_store_n(&ring->tail, ring->tail + 1, __ATOMIC_RELEASE);
+}
@@ -0,0 +1,64 @@
+/*
+ * Anachro Mouse, a usb to serial mouse adaptor. Copyright (C) 2025 Aviancer <oss+amouse@skyvian.me>
+ *
+ * This library is free software; you can redistribute it and/or modify it under the terms of the 
+ * GNU Lesser General Public License as published by the Free Software Foundation; either version 
+ * 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without 
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the 
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with this library; 
+ * if not, write to the Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+*/
+
+#ifndef TXRING_H_
+#define TXRING_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define TX_CHUNK_MAX 16 // Bytes per chunk, a whole packet or piece of console text
+#define TX_RING_SIZE 32 // Chunks, must be a power of two
+
+enum TX_CHUNK_TYPES {
+  TX_CHUNK_PACKET = 0, // Mouse packet or ident
+  TX_CHUNK_TEXT   = 1, // Console output
+  TX_CHUNK_MOTION = 2  // Mouse packet without button changes, may be superseded by a newer one
+};
+
+typedef struct tx_chunk {
+  uint8_t len;
+  uint8_t type;
+  uint8_t data[TX_CHUNK_MAX];
+} tx_chunk_t;
+
+// Single producer, single consumer ring of chunks. Head is only written by the producer and tail only by 
+// the consumer, so neither side needs a lock. Counters run freely and wrap, level is head - tail.
+typedef struct tx_ring {
+  tx_chunk_t chunks[TX_RING_SIZE];
+  uint32_t head;
+  uint32_t tail;
+} tx_ring_t;
+
+/* Functions */
+
+void tx_ring_init(tx_ring_t *ring);
+
+uint32_t tx_ring_level(tx_ring_t *ring);
+
+bool tx_ring_empty(tx_ring_t *ring);
+
+tx_chunk_t* tx_ring_claim(tx_ring_t *ring);
+
+void tx_ring_publish(tx_ring_t *ring, int len, int type);
+
+bool tx_ring_retract(tx_ring_t *ring, int type);
+
+tx_chunk_t const* tx_ring_peek(tx_ring_t *ring);
+
+void tx_ring_release(tx_ring_t *ring);
+
+#endif // TXRING_H_
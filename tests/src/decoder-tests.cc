@@ -0,0 +1,112 @@
+#include <gtest/gtest.h>
+
+extern "C" {
+  #include "../../linux/tools/decoder.h"
+  #include "../../shared/mouse.h"
+}
+
+class DecoderTest : public testing::Test {
+  protected:
+
+  mouse_state_t mouse;
+  packet_decoder_t decoder;
+  decoded_packet_t packet;
+
+  // Per-test set-up logic as usual.
+  void SetUp() override {
+    memset(&mouse, 0, sizeof(mouse));
+    reset_mouse_state(&mouse);
+    g_mouse_options.sensitivity = SENSITIVITY_ONE;
+    g_mouse_options.swap_buttons = false;
+    g_mouse_options.wheel_short = false;
+    g_mouse_options.motion_carry = false;
+  }
+ 
+  // Per-test tear-down logic
+  void TearDown() override {  }
+
+  void use_protocol(int protocol) {
+    g_mouse_options.protocol = protocol;
+    apply_mouse_options();
+    decoder_init(&decoder, protocol);
+  }
+
+  // Encode a packet with the shared encoders and feed it to decoder, true if a packet came out.
+  bool send(int x, int y, int wheel, bool full_packet) {
+    bool complete = false;
+    mouse.x = x;
+    mouse.y = y;
+    mouse.wheel = wheel;
+    push_update(&mouse, full_packet);
+    update_mouse_state(&mouse);
+    for(int i=0; i < mouse.update; i++) { complete |= decoder_feed(&decoder, mouse.state[i], 0, &packet); }
+    reset_mouse_state(&mouse);
+    return complete;
+  }
+
+ };
+
+
+/*** Round trips through encoders ***/
+
+TEST_F(DecoderTest, Ms2Button) {
+  use_protocol(PROTO_MS2BUTTON);
+  mouse.lmb = true;
+  ASSERT_TRUE(send(-100, 65, 0, false));
+  EXPECT_EQ(packet.x, -100);
+  EXPECT_EQ(packet.y, 65);
+  EXPECT_TRUE(packet.lmb);
+  EXPECT_FALSE(packet.rmb);
+  EXPECT_EQ(decoder.sync_errors, 0);
+}
+
+TEST_F(DecoderTest, WheelPacket) {
+  use_protocol(PROTO_MSWHEEL);
+  mouse.mmb = true;
+  ASSERT_TRUE(send(3, -4, -2, true));
+  EXPECT_EQ(packet.len, 4);
+  EXPECT_EQ(packet.x, 3);
+  EXPECT_EQ(packet.y, -4);
+  EXPECT_EQ(packet.wheel, -2);
+  EXPECT_TRUE(packet.mmb);
+}
+
+TEST_F(DecoderTest, ShortPacketCompletesOnNextSync) {
+  use_protocol(PROTO_MSWHEEL);
+  g_mouse_options.wheel_short = true;
+  EXPECT_FALSE(send(5, 0, 0, false)); // 3 bytes, 4th may still follow
+  ASSERT_TRUE(send(0, 7, 0, false));
+  EXPECT_EQ(packet.len, 3);
+  EXPECT_EQ(packet.x, 5);
+  ASSERT_TRUE(decoder_flush(&decoder, &packet));
+  EXPECT_EQ(packet.len, 3);
+  EXPECT_EQ(packet.y, 7);
+  EXPECT_EQ(packet.wheel, 0);
+}
+
+TEST_F(DecoderTest, LogitechMiddleButton) {
+  use_protocol(PROTO_LOGITECH);
+  mouse.mmb = true;
+  ASSERT_TRUE(send(1, 1, 0, true));
+  EXPECT_TRUE(packet.mmb);
+  EXPECT_EQ(packet.len, 4);
+}
+
+TEST_F(DecoderTest, MouseSystems) {
+  use_protocol(PROTO_MOUSESYS);
+  mouse.rmb = true;
+  ASSERT_TRUE(send(-201, 99, 0, false));
+  EXPECT_EQ(packet.x, -201);
+  EXPECT_EQ(packet.y, 99);
+  EXPECT_TRUE(packet.rmb);
+  EXPECT_FALSE(packet.lmb);
+}
+
+TEST_F(DecoderTest, ResyncsAfterGarbage) {
+  use_protocol(PROTO_MS2BUTTON);
+  decoder_feed(&decoder, 0x12, 0, &packet);
+  decoder_feed(&decoder, 0x3f, 0, &packet);
+  ASSERT_TRUE(send(2, 2, 0, false));
+  EXPECT_EQ(packet.x, 2);
+  EXPECT_EQ(decoder.sync_errors, 2);
+}
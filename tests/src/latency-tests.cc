@@ -0,0 +1,76 @@
+#include <gtest/gtest.h>
+
+extern "C" {
+  #include "../../linux/src/include/latency.h"
+}
+
+class LatencyTest : public testing::Test {
+  protected:
+
+  latency_stats_t stats;
+
+  // Per-test set-up logic as usual.
+  void SetUp() override {
+    memset(&stats, 0, sizeof(stats));
+  }
+ 
+  // Per-test tear-down logic
+  void TearDown() override {  }
+
+ };
+
+
+/*** Histograms ***/
+
+TEST_F(LatencyTest, PercentileIsBucketBound) {
+  latency_hist_t *hist = &stats.hist[LAT_ENCODE_TO_WRITE];
+  for(int i=0; i < 99; i++) { latency_record(hist, 3000); } // 3us, bucket [2, 4)
+  latency_record(hist, 5000000); // 5ms outlier
+
+  EXPECT_EQ(hist->count, 100u);
+  EXPECT_EQ(latency_percentile(hist, 500), 4000u);
+  EXPECT_EQ(latency_percentile(hist, 990), 4000u);
+  EXPECT_EQ(latency_percentile(hist, 1000), 5000000u); // Capped to max
+  EXPECT_EQ(hist->max, 5000000u);
+}
+
+TEST_F(LatencyTest, EmptyHistogram) {
+  EXPECT_EQ(latency_percentile(&stats.hist[LAT_TX_JITTER], 500), 0u);
+}
+
+// Packet is measured from the oldest event aggregated into it
+TEST_F(LatencyTest, PacketUsesOldestEvent) {
+  latency_mark_event(&stats, 1000000);
+  latency_mark_event(&stats, 9000000);
+  latency_packet(&stats, 11000000, 11500000);
+
+  EXPECT_EQ(stats.hist[LAT_EVENT_TO_ENCODE].max, 10000000u);
+  EXPECT_EQ(stats.hist[LAT_EVENT_TO_WRITE].max, 10500000u);
+  EXPECT_EQ(stats.hist[LAT_ENCODE_TO_WRITE].max, 500000u);
+  EXPECT_EQ(stats.event_ns, 0u); // Ready for next packet
+}
+
+// Packet waiting on the schedule is measured from its deadline
+TEST_F(LatencyTest, TxJitterFromDeadline) {
+  latency_mark_event(&stats, 1000000);
+  latency_tx_jitter(&stats, 2050000, 2000000);
+
+  EXPECT_EQ(stats.hist[LAT_TX_JITTER].count, 1u);
+  EXPECT_EQ(stats.hist[LAT_TX_JITTER].max, 50000u);
+}
+
+// First packet after the mouse sat still, deadline expired seconds before the event
+TEST_F(LatencyTest, TxJitterIgnoresIdleGap) {
+  latency_mark_event(&stats, 5000000000ULL);
+  latency_tx_jitter(&stats, 5000020000ULL, 1000000);
+
+  EXPECT_EQ(stats.hist[LAT_TX_JITTER].max, 20000u);
+}
+
+// Button change sent ahead of the deadline is not a pacing error
+TEST_F(LatencyTest, TxJitterSkipsEarlyPackets) {
+  latency_mark_event(&stats, 1000000);
+  latency_tx_jitter(&stats, 1500000, 2000000);
+
+  EXPECT_EQ(stats.hist[LAT_TX_JITTER].count, 0u);
+}
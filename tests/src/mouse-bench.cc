@@ -0,0 +1,194 @@
+// Benchmarks for the shared mouse pipeline, not part of the test suite.
+// Usage: mouse-bench [protocol] [iterations]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+extern "C" {
+  #include "../../linux/src/include/input.h"
+  #include "../../shared/mouse.h"
+  #include "../../shared/pacing.h"
+}
+
+#define BENCH_SECONDS 10 // Virtual time each scenario covers
+
+typedef struct bench_stats {
+  uint64_t events;
+  uint64_t packets;
+  uint64_t lost;         // Motion counts dropped by clamping, summed per packet and axis
+  uint64_t ns_total;    // Wall time for whole scenario
+  uint64_t ns_encode;   // Wall time spent building packets
+} bench_stats_t;
+
+typedef struct bench_run {
+  mouse_state_t mouse;
+  tx_schedule_t tx_schedule;
+  serial_line_t line;
+  bench_stats_t *stats;
+} bench_run_t;
+
+// Scenario fills in the frame for the given frame number.
+typedef void (*scenario_fn)(uint64_t n, mouse_frame_t *frame);
+
+typedef struct scenario {
+  const char *name;
+  int rate; // Frames per second
+  scenario_fn frame;
+} scenario_t;
+
+
+/*** Scenarios ***/
+
+static void slow_drag(uint64_t n, mouse_frame_t *frame) {
+  if(n == 0) { frame->lmb = 1; }
+  frame->x = 1;
+  frame->y = (n % 3 == 0) ? 1 : 0;
+}
+
+// 200ms flicks with 300ms rest in between
+static void fast_flick(uint64_t n, mouse_frame_t *frame) {
+  if(n % 500 < 200) {
+    frame->x = ((n / 500) % 2) ? -40 : 40;
+    frame->y = -12;
+  }
+}
+
+static void click_storm(uint64_t n, mouse_frame_t *frame) {
+  if(n % 2 == 0) { frame->lmb = (n / 2) % 2; }
+  if(n % 7 == 0) { frame->rmb = (n / 7) % 2; }
+  frame->x = (n % 5 == 0) ? 1 : 0;
+}
+
+static void wheel_spin(uint64_t n, mouse_frame_t *frame) {
+  frame->wheel = (n / 250) % 2 ? -1 : 1;
+  if(n % 10 == 0) { frame->y = 1; }
+}
+
+static void mouse_8khz(uint64_t n, mouse_frame_t *frame) {
+  frame->x = 3;
+  frame->y = (n % 2) ? 2 : -1;
+}
+
+static const scenario_t scenarios[] = {
+  { "slow drag",   125,  slow_drag   },
+  { "fast flick",  1000, fast_flick  },
+  { "click storm", 1000, click_storm },
+  { "wheel spin",  500,  wheel_spin  },
+  { "8 kHz mouse", 8000, mouse_8khz  },
+};
+
+
+/*** Pipeline ***/
+
+static uint64_t wall_ns() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Motion the host would see from the packet.
+static void decode_motion(bench_run_t *run, int64_t *x, int64_t *y) {
+  uint8_t *packet = run->mouse.state;
+
+  if(g_mouse_options.protocol == PROTO_MOUSESYS) {
+    *x = (int8_t)packet[1] + (int8_t)packet[3];
+    *y = -((int8_t)packet[2] + (int8_t)packet[4]);
+  }
+  else {
+    *x = (int8_t)(((packet[0] & 0x03) << 6) | (packet[1] & 0x3f));
+    *y = (int8_t)(((packet[0] & 0x0c) << 4) | (packet[2] & 0x3f));
+  }
+}
+
+// Loss is counted per packet with absolute values, so drops in opposite directions don't cancel out.
+// Motion carried over to the next packet is not lost. Sensitivity is 1.0 so aggregated counts go out as is.
+static void transmit(bench_run_t *run, uint64_t now) {
+  int64_t in_x = run->mouse.x + run->mouse.carry_x;
+  int64_t in_y = run->mouse.y + run->mouse.carry_y;
+  int64_t out_x = 0, out_y = 0;
+
+  uint64_t start = wall_ns();
+  encode_mouse_packet(&run->mouse, &run->tx_schedule, &run->line, now);
+  run->stats->ns_encode += wall_ns() - start;
+
+  if(run->mouse.update > 0) {
+    decode_motion(run, &out_x, &out_y);
+    run->stats->packets++;
+  }
+  run->stats->lost += llabs(in_x - out_x - run->mouse.carry_x) + llabs(in_y - out_y - run->mouse.carry_y);
+  reset_mouse_state(&run->mouse);
+}
+
+// Same transmit decisions as the amouse main loop, on a virtual clock.
+static void run_scenario(scenario_t const *scenario, bench_stats_t *stats) {
+  bench_run_t run = {};
+  uint64_t frames = (uint64_t)scenario->rate * BENCH_SECONDS;
+  uint64_t period = NS_FULL_SECOND / scenario->rate;
+  uint64_t now = 0;
+  mouse_frame_t frame;
+
+  run.stats = stats;
+  run.mouse.pc_state = CTS_TOGGLED;
+  reset_mouse_state(&run.mouse);
+  reset_line_state(&run.mouse);
+  line_init(&run.line, NS_FULL_SECOND, MOUSE_BAUD_DEFAULT, g_mouse_protocol[g_mouse_options.protocol].data_bits, 0, 1);
+  tx_schedule_init(&run.tx_schedule, 0, line_time(&run.line, 1));
+
+  uint64_t start = wall_ns();
+  for(uint64_t n=0; n < frames; n++) {
+    now = n * period;
+    while(run.mouse.update > -1 && run.tx_schedule.deadline <= now) { transmit(&run, run.tx_schedule.deadline); }
+
+    frame = empty_frame;
+    scenario->frame(n, &frame);
+    stats->events += (frame.x != 0) + (frame.y != 0) + (frame.wheel != 0) + frame_has_buttons(&frame);
+
+    if(frame_has_buttons(&frame) && run.mouse.force_update) { transmit(&run, now); }
+    process_mouse_report(&run.mouse, &frame);
+    if((run.mouse.update > -1 && tx_schedule_due(&run.tx_schedule, now)) || run.mouse.force_update) {
+      transmit(&run, now);
+    }
+  }
+  // Let carried motion drain out
+  while(run.mouse.update > -1) { transmit(&run, run.tx_schedule.deadline); }
+  stats->ns_total += wall_ns() - start;
+}
+
+
+/*** Main ***/
+
+static void bench(int iterations) {
+  printf("%-12s %12s %10s %12s %12s %12s\n", "Scenario", "events/s", "packets/s", "lost counts", "ns/event", "ns/packet");
+
+  for(auto const &scenario : scenarios) {
+    bench_stats_t stats = {};
+    for(int i=0; i < iterations; i++) { run_scenario(&scenario, &stats); }
+
+    printf("%-12s %12.0f %10.1f %12lld %12.1f %12.1f\n", scenario.name,
+      stats.events * 1e9 / (stats.ns_total ? stats.ns_total : 1),            // Pipeline throughput, wall clock
+      (double)stats.packets / iterations / BENCH_SECONDS,                    // Achieved report rate, virtual clock
+      (long long)(stats.lost / iterations),
+      (double)stats.ns_total / (stats.events ? stats.events : 1),
+      (double)stats.ns_encode / (stats.packets ? stats.packets : 1));
+  }
+}
+
+int main(int argc, char **argv) {
+  int iterations = 20;
+
+  g_mouse_options.protocol = PROTO_MSWHEEL;
+  g_mouse_options.sensitivity = SENSITIVITY_ONE;
+  if(argc > 1) { g_mouse_options.protocol = atoi(argv[1]) % g_mouse_protocol_num; }
+  if(argc > 2) { iterations = atoi(argv[2]) > 0 ? atoi(argv[2]) : 1; }
+
+  for(int carry=0; carry <= 1; carry++) {
+    g_mouse_options.motion_carry = carry;
+    g_mouse_options.carry_decay = CARRY_DECAY_NONE;
+    apply_mouse_options();
+
+    printf("\n%s, motion carry-over %s, %d iterations of %d s\n", g_mouse_protocol[g_mouse_options.protocol].name, 
+      carry ? "on" : "off", iterations, BENCH_SECONDS);
+    bench(iterations);
+  }
+  return 0;
+}
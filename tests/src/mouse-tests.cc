@@ -0,0 +1,364 @@
+#include <gtest/gtest.h>
+
+extern "C" {
+  #include "../../shared/mouse.h"
+}
+
+class MouseTest : public testing::Test {
+  protected:
+
+  mouse_state_t mouse;
+
+  // Per-test set-up logic as usual.
+  void SetUp() override {
+    memset(&mouse, 0, sizeof(mouse));
+    reset_mouse_state(&mouse);
+    reset_line_state(&mouse);
+
+    g_mouse_options.protocol = PROTO_MS2BUTTON;
+    g_mouse_options.sensitivity = SENSITIVITY_ONE;
+    g_mouse_options.swap_buttons = false;
+    g_mouse_options.wheel = false;
+    g_mouse_options.wheel_short = false;
+    g_mouse_options.accel_curve = ACCEL_LINEAR;
+    g_mouse_options.accel_points_num = 0;
+    apply_mouse_options();
+  }
+ 
+  // Per-test tear-down logic
+  void TearDown() override {  }
+
+ };
+
+
+/*** Protocol encoders ***/
+
+TEST_F(MouseTest, EncodesMs2ButtonPacket) {
+  mouse.x = -1;
+  mouse.y = 65;
+  mouse.lmb = true;
+  push_update(&mouse, false);
+  update_mouse_state(&mouse);
+
+  EXPECT_EQ(mouse.update, 3);
+  EXPECT_EQ(mouse.state[0], 0x40 | 0x20 | 0x04 | 0x03);
+  EXPECT_EQ(mouse.state[1], 0x3f);
+  EXPECT_EQ(mouse.state[2], 0x01);
+}
+
+TEST_F(MouseTest, SwappedButtonsEncodeMirrored) {
+  g_mouse_options.swap_buttons = true;
+  mouse.lmb = true;
+  push_update(&mouse, false);
+  update_mouse_state(&mouse);
+
+  EXPECT_EQ(mouse.state[0], 0x40 | 0x10);
+}
+
+TEST_F(MouseTest, EncodesWheelPacket) {
+  g_mouse_options.protocol = PROTO_MSWHEEL;
+  apply_mouse_options();
+  mouse.wheel = -20; // Clamped to -15
+  mouse.mmb = true;
+  push_update(&mouse, false);
+  update_mouse_state(&mouse);
+
+  EXPECT_EQ(mouse.update, 4);
+  EXPECT_EQ(mouse.state[3], 0x10 | 0x0f);
+}
+
+TEST_F(MouseTest, ShortWheelPacketsWhenIdle) {
+  g_mouse_options.protocol = PROTO_MSWHEEL;
+  g_mouse_options.wheel_short = true;
+  apply_mouse_options();
+
+  mouse.x = 10; // Motion only
+  push_update(&mouse, false);
+  update_mouse_state(&mouse);
+  EXPECT_EQ(mouse.update, 3);
+  reset_mouse_state(&mouse);
+
+  mouse.wheel = 1; // Wheel activity needs the 4th byte
+  push_update(&mouse, true);
+  update_mouse_state(&mouse);
+  EXPECT_EQ(mouse.update, 4);
+  EXPECT_EQ(mouse.state[3], 0x0f);
+}
+
+TEST_F(MouseTest, LogitechSendsMmbByteOnlyWhenNeeded) {
+  g_mouse_options.protocol = PROTO_LOGITECH;
+  apply_mouse_options();
+
+  mouse.x = 1;
+  push_update(&mouse, false);
+  update_mouse_state(&mouse);
+  EXPECT_EQ(mouse.update, 3);
+  reset_mouse_state(&mouse);
+
+  mouse.mmb = true;
+  push_update(&mouse, true);
+  update_mouse_state(&mouse);
+  EXPECT_EQ(mouse.update, 4);
+  EXPECT_EQ(mouse.state[3], 0x20);
+  reset_mouse_state(&mouse);
+
+  mouse.mmb = false; // Release is sent as 4 bytes too
+  push_update(&mouse, true);
+  update_mouse_state(&mouse);
+  EXPECT_EQ(mouse.update, 4);
+  EXPECT_EQ(mouse.state[3], 0x00);
+}
+
+
+TEST_F(MouseTest, EncodesMouseSystemsPacket) {
+  g_mouse_options.protocol = PROTO_MOUSESYS;
+  apply_mouse_options();
+  mouse.x = 201; // Over MS limits, fits in two deltas
+  mouse.y = -5;  // Up, positive in Mouse Systems
+  mouse.lmb = true;
+  push_update(&mouse, false);
+  update_mouse_state(&mouse);
+
+  EXPECT_EQ(mouse.update, 5);
+  EXPECT_EQ(mouse.state[0], 0x80 | 0x03); // Buttons active low
+  EXPECT_EQ((int8_t)mouse.state[1] + (int8_t)mouse.state[3], 201);
+  EXPECT_EQ((int8_t)mouse.state[2] + (int8_t)mouse.state[4], 5);
+  EXPECT_EQ((int8_t)mouse.state[1], 101);
+  EXPECT_EQ((int8_t)mouse.state[3], 100);
+}
+
+
+/*** Sensitivity scaling ***/
+
+TEST_F(MouseTest, SensitivityOneIsIdentity) {
+  mouse.x = 100;
+  mouse.y = -37;
+  input_sensitivity(&mouse);
+
+  EXPECT_EQ(mouse.x, 100);
+  EXPECT_EQ(mouse.y, -37);
+}
+
+// Slow movements at low sensitivity must add up over packets rather than truncate to zero
+TEST_F(MouseTest, SensitivityCarriesFraction) {
+  g_mouse_options.sensitivity = SENSITIVITY_FROM_STEPS(1); // 0.2
+  int total_x = 0, total_y = 0;
+
+  for(int i=0; i < 50; i++) {
+    mouse.x = 1;
+    mouse.y = -1;
+    input_sensitivity(&mouse);
+    total_x += mouse.x;
+    total_y += mouse.y;
+  }
+
+  EXPECT_NEAR(total_x, 10, 1);
+  EXPECT_EQ(total_x, -total_y); // Both directions scale the same
+}
+
+TEST_F(MouseTest, SetSensitivityFromTenths) {
+  scan_int_t scan_i = { true, 11, 0 };
+  set_sensitivity(scan_i);
+  EXPECT_EQ(SENSITIVITY_TO_TENTHS(g_mouse_options.sensitivity), 11);
+
+  scan_i.value = 99; // Clamped to 3.0
+  set_sensitivity(scan_i);
+  EXPECT_EQ(g_mouse_options.sensitivity, SENSITIVITY_MAX);
+}
+
+
+/*** Acceleration ***/
+
+TEST_F(MouseTest, PowerCurveAcceleratesFastMotion) {
+  g_mouse_options.accel_curve = ACCEL_POWER;
+  build_accel_lut();
+
+  mouse.x = 1; // Slow movement stays at gain 1.0
+  input_sensitivity(&mouse);
+  EXPECT_EQ(mouse.x, 1);
+
+  mouse.x = ACCEL_POWER_KNEE; // Gain 2.0 at knee
+  mouse.x_frac = 0;
+  input_sensitivity(&mouse);
+  EXPECT_EQ(mouse.x, 2 * ACCEL_POWER_KNEE);
+
+  mouse.x = -500; // Capped gain, mirrored for negative motion
+  mouse.x_frac = 0;
+  input_sensitivity(&mouse);
+  EXPECT_EQ(mouse.x, -500 * ACCEL_GAIN_MAX / SENSITIVITY_ONE);
+}
+
+// Settings may say custom but points are never stored, don't keep an empty curve
+TEST_F(MouseTest, CustomCurveWithoutPointsIsLinear) {
+  g_mouse_options.accel_curve = ACCEL_CUSTOM;
+  g_mouse_options.accel_points_num = 0;
+  apply_mouse_options();
+
+  EXPECT_EQ(g_mouse_options.accel_curve, ACCEL_LINEAR);
+}
+
+TEST_F(MouseTest, CustomCurveInterpolatesPoints) {
+  g_mouse_options.accel_curve = ACCEL_CUSTOM;
+  g_mouse_options.accel_points[0] = { 10, SENSITIVITY_ONE / 2 };
+  g_mouse_options.accel_points[1] = { 30, 2 * SENSITIVITY_ONE };
+  g_mouse_options.accel_points_num = 2;
+  build_accel_lut();
+
+  mouse.x = 4; // Below first point
+  input_sensitivity(&mouse);
+  EXPECT_EQ(mouse.x, 2);
+
+  mouse.x = 20; // Halfway, gain 1.25
+  mouse.x_frac = 0;
+  input_sensitivity(&mouse);
+  EXPECT_EQ(mouse.x, 25);
+
+  mouse.x = 100; // Past last point
+  mouse.x_frac = 0;
+  input_sensitivity(&mouse);
+  EXPECT_EQ(mouse.x, 200);
+}
+
+TEST_F(MouseTest, AccelerationCombinesWithSensitivity) {
+  g_mouse_options.accel_curve = ACCEL_POWER;
+  g_mouse_options.sensitivity = SENSITIVITY_ONE / 2;
+  build_accel_lut();
+
+  mouse.y = -ACCEL_POWER_KNEE;
+  input_sensitivity(&mouse);
+  EXPECT_EQ(mouse.y, -ACCEL_POWER_KNEE);
+}
+
+
+/*** Motion carry-over ***/
+
+TEST_F(MouseTest, ClampsWithoutCarry) {
+  mouse.x = 300;
+  push_update(&mouse, false);
+  update_mouse_state(&mouse);
+  EXPECT_EQ(mouse.x, MOUSE_MOTION_MAX);
+
+  reset_mouse_state(&mouse);
+  EXPECT_EQ(mouse.update, -1); // Excess was discarded
+}
+
+TEST_F(MouseTest, CarryKeepsExcessMotion) {
+  g_mouse_options.motion_carry = true;
+  g_mouse_options.carry_decay = CARRY_DECAY_NONE;
+  g_mouse_options.carry_cap = 3;
+  int total_x = 0;
+
+  mouse.x = 300;
+  mouse.y = -10;
+  push_update(&mouse, false);
+  for(int i=0; i < 5 && mouse.update > -1; i++) {
+    update_mouse_state(&mouse);
+    total_x += mouse.x;
+    reset_mouse_state(&mouse);
+  }
+
+  EXPECT_EQ(total_x, 300);
+  EXPECT_EQ(mouse.update, -1); // Nothing left to send
+}
+
+TEST_F(MouseTest, CarryCapLimitsBacklog) {
+  g_mouse_options.motion_carry = true;
+  g_mouse_options.carry_decay = CARRY_DECAY_NONE;
+  g_mouse_options.carry_cap = 0;
+
+  mouse.x = 5000;
+  push_update(&mouse, false);
+  update_mouse_state(&mouse);
+
+  EXPECT_EQ(mouse.carry_x, CARRY_CAP_COUNTS(0));
+}
+
+TEST_F(MouseTest, CarryDropsWhenStopped) {
+  g_mouse_options.motion_carry = true;
+  g_mouse_options.carry_decay = CARRY_DECAY_STOP;
+  g_mouse_options.carry_cap = 3;
+
+  mouse.x = 300;
+  push_update(&mouse, false);
+  update_mouse_state(&mouse);
+  reset_mouse_state(&mouse);
+  update_mouse_state(&mouse); // No new input since
+
+  EXPECT_EQ(mouse.x, 0);
+  EXPECT_EQ(mouse.carry_x, 0);
+}
+
+// Turning carry-over off drops carried motion instead of requesting empty packets forever
+TEST_F(MouseTest, CarryOffDropsCarriedMotion) {
+  g_mouse_options.motion_carry = true;
+  g_mouse_options.carry_decay = CARRY_DECAY_NONE;
+  g_mouse_options.carry_cap = 3;
+
+  mouse.x = 300;
+  push_update(&mouse, false);
+  update_mouse_state(&mouse);
+  reset_mouse_state(&mouse);
+  ASSERT_NE(mouse.carry_x, 0);
+
+  g_mouse_options.motion_carry = false;
+  update_mouse_state(&mouse);
+  reset_mouse_state(&mouse);
+
+  EXPECT_EQ(mouse.carry_x, 0);
+  EXPECT_EQ(mouse.update, -1); // Nothing left to send
+}
+
+// Driver re-init must not receive motion carried from before it
+TEST_F(MouseTest, IdentDropsCarriedMotion) {
+  g_mouse_options.motion_carry = true;
+  g_mouse_options.carry_decay = CARRY_DECAY_NONE;
+  g_mouse_options.carry_cap = 3;
+  g_mouse_options.sensitivity = SENSITIVITY_ONE / 2;
+
+  mouse.x = 301;
+  push_update(&mouse, false);
+  input_sensitivity(&mouse);
+  update_mouse_state(&mouse);
+  reset_mouse_state(&mouse);
+  ASSERT_NE(mouse.carry_x, 0);
+  ASSERT_NE(mouse.x_frac, 0);
+
+  reset_motion_backlog(&mouse);
+
+  EXPECT_EQ(mouse.carry_x, 0);
+  EXPECT_EQ(mouse.x_frac, 0);
+  EXPECT_EQ(mouse.update, -1); // No packet requested for old motion
+}
+
+
+/*** Logitech host commands ***/
+
+TEST_F(MouseTest, LogitechBaudCommand) {
+  EXPECT_EQ(logitech_command(&mouse, '*'), LOGI_CMD_NONE);
+  EXPECT_EQ(logitech_command(&mouse, 'q'), LOGI_CMD_BAUD);
+  EXPECT_EQ(mouse.baud, 9600u);
+
+  EXPECT_EQ(logitech_command(&mouse, 'q'), LOGI_CMD_NONE); // Prefix is consumed
+  EXPECT_EQ(logitech_command(&mouse, '*' | 0x80), LOGI_CMD_NONE); // 8th bit ignored
+  EXPECT_EQ(logitech_command(&mouse, 'n'), LOGI_CMD_BAUD);
+  EXPECT_EQ(mouse.baud, 1200u);
+}
+
+TEST_F(MouseTest, LogitechRateCommand) {
+  EXPECT_EQ(logitech_command(&mouse, 'Q'), LOGI_CMD_RATE);
+  EXPECT_EQ(mouse.report_rate, 100);
+  EXPECT_EQ(logitech_command(&mouse, 'O'), LOGI_CMD_RATE);
+  EXPECT_EQ(mouse.report_rate, 0);
+}
+
+TEST_F(MouseTest, PacketIntervalFollowsReportRate) {
+  EXPECT_EQ(packet_interval(&mouse, 2812, U_FULL_SECOND), 2812u); // 3 bytes at 9600 baud
+
+  mouse.report_rate = 100; // Rate limit is longer than line time
+  EXPECT_EQ(packet_interval(&mouse, 2812, U_FULL_SECOND), (uint64_t)(U_FULL_SECOND / 100));
+  EXPECT_EQ(packet_interval(&mouse, 22500, U_FULL_SECOND), 22500u); // Line is slower than rate
+
+  reset_line_state(&mouse);
+  EXPECT_EQ(mouse.baud, (uint32_t)MOUSE_BAUD_DEFAULT);
+  EXPECT_EQ(mouse.report_rate, 0);
+}
@@ -0,0 +1,122 @@
+#include <gtest/gtest.h>
+
+extern "C" {
+  #include "../../shared/pacing.h"
+}
+
+class PacingTest : public testing::Test {
+  protected:
+
+  tx_schedule_t sched;
+
+  // Per-test set-up logic as usual.
+  void SetUp() override {
+    tx_schedule_init(&sched, 1000, 75); // Microseconds, budget of 75
+  }
+ 
+  // Per-test tear-down logic
+  void TearDown() override {  }
+
+ };
+
+
+/*** Transmit timeline ***/
+
+TEST_F(PacingTest, DueFromStart) {
+  EXPECT_TRUE(tx_schedule_due(&sched, 1000));
+  EXPECT_FALSE(tx_schedule_due(&sched, 999));
+}
+
+// Being late within budget does not push the timeline back
+TEST_F(PacingTest, LatenessDoesNotDrift) {
+  uint64_t now = 1000;
+
+  for(int i=0; i < 1000; i++) {
+    now = sched.deadline + 50; // Loop always wakes up 50 late
+    tx_schedule_advance(&sched, now, 22500);
+  }
+
+  EXPECT_EQ(sched.deadline, 1000 + 1000 * 22500ULL);
+}
+
+// Line has been idle, restart timeline instead of bursting to catch up
+TEST_F(PacingTest, IdleReanchors) {
+  tx_schedule_advance(&sched, 1000, 22500);
+  tx_schedule_advance(&sched, 500000, 22500);
+
+  EXPECT_EQ(sched.deadline, 500000 + 22500ULL);
+}
+
+// Packet sent ahead of deadline queues behind the previous one
+TEST_F(PacingTest, EarlySendQueues) {
+  tx_schedule_advance(&sched, 1000, 22500);
+  tx_schedule_advance(&sched, 2000, 30000);
+
+  EXPECT_EQ(sched.deadline, 1000 + 22500ULL + 30000);
+}
+
+TEST_F(PacingTest, DeferFromNow) {
+  tx_schedule_defer(&sched, 5000, 7500);
+
+  EXPECT_FALSE(tx_schedule_due(&sched, 12499));
+  EXPECT_TRUE(tx_schedule_due(&sched, 12500));
+}
+
+// Packet taken back off the line gives its airtime back
+TEST_F(PacingTest, RewindReturnsAirtime) {
+  tx_schedule_advance(&sched, 1000, 22500);
+  tx_schedule_advance(&sched, 1000, 22500);
+  tx_schedule_rewind(&sched, 22500);
+
+  EXPECT_EQ(sched.deadline, 1000 + 22500ULL);
+}
+
+// Budget tracks the line, one byte at whatever rate it runs now
+TEST_F(PacingTest, BudgetFollowsLine) {
+  serial_line_t line;
+  line_init(&line, 1000000, 1200, 7, 0, 1);
+  tx_schedule_follow_line(&sched, &line);
+  EXPECT_EQ(sched.budget, 7500u);
+
+  line_set_baud(&line, 9600);
+  tx_schedule_follow_line(&sched, &line);
+  EXPECT_EQ(sched.budget, 938u); // Rounded up
+
+  // Late by more than a byte at 9600 re-anchors instead of bursting
+  tx_schedule_advance(&sched, sched.deadline + 2000, 3750);
+  EXPECT_EQ(sched.deadline, 1000 + 2000 + 3750ULL);
+}
+
+
+/*** Serial line model ***/
+
+TEST_F(PacingTest, LineTimeAt7N1) {
+  serial_line_t line;
+  line_init(&line, 1000000, 1200, 7, 0, 1);
+
+  EXPECT_EQ(line_time(&line, 1), 7500u);
+  EXPECT_EQ(line_airtime(&line, 3), 22500u);
+  EXPECT_EQ(line_airtime(&line, 4), 30000u);
+}
+
+// 8N1 bytes are not a whole number of microseconds, remainder must not get lost over packets
+TEST_F(PacingTest, LineAirtimeCarriesRemainder) {
+  serial_line_t line;
+  uint64_t total = 0;
+  line_init(&line, 1000000, 1200, 8, 0, 1);
+
+  EXPECT_EQ(line_time(&line, 5), 41667u); // Rounded up
+  for(int i=0; i < 1200; i++) { total += line_airtime(&line, 5); }
+  EXPECT_EQ(total, 50 * 1000000ULL); // 1200 packets of 50 bits at 1200 baud
+}
+
+TEST_F(PacingTest, LineFormatAndBaud) {
+  serial_line_t line;
+  line_init(&line, 1000000000, 1200, 7, 0, 1);
+
+  line_set_baud(&line, 9600);
+  EXPECT_EQ(line_airtime(&line, 3), 2812500u);
+
+  line_set_format(&line, 8, 1, 2); // 8E2, 12 bits per byte
+  EXPECT_EQ(line_time(&line, 4), 5000000u);
+}
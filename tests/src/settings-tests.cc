@@ -80,11 +80,11 @@ TEST_F(SettingsTest, DecodeFailsVersion) {
 
 TEST_F(SettingsTest, EncodeSucceeds) {
 
-  mouse_opts_t mouse_options;
+  mouse_opts_t mouse_options = {};
   uint8_t test_binary_settings[SETTINGS_SIZE] = {0};
 
   mouse_options.protocol = PROTO_MS2BUTTON;
-  mouse_options.sensitivity = 1.0;
+  mouse_options.sensitivity = SENSITIVITY_ONE;
   mouse_options.swap_buttons = false;
   mouse_options.wheel = false;
 
@@ -101,18 +101,18 @@ TEST_F(SettingsTest, DecodeSucceeds) {
   EXPECT_TRUE(settings_decode(&binary_settings[0], &mouse_options));
 
   EXPECT_EQ(mouse_options.protocol, PROTO_MS2BUTTON);
-  EXPECT_EQ(mouse_options.sensitivity, 1.0);
+  EXPECT_EQ(mouse_options.sensitivity, SENSITIVITY_ONE);
   EXPECT_EQ(mouse_options.swap_buttons, false);
   EXPECT_EQ(mouse_options.wheel, false);
 }
 
 TEST_F(SettingsTest, EncodeDecodeSucceeds) {
 
-  mouse_opts_t mouse_options;
+  mouse_opts_t mouse_options = {};
   uint8_t binary_settings[SETTINGS_SIZE];
 
   mouse_options.protocol = PROTO_MS2BUTTON;
-  mouse_options.sensitivity = 1.0;
+  mouse_options.sensitivity = SENSITIVITY_ONE;
   mouse_options.swap_buttons = true;
   mouse_options.wheel = true;
 
@@ -122,7 +122,32 @@ TEST_F(SettingsTest, EncodeDecodeSucceeds) {
   EXPECT_TRUE(settings_decode(&binary_settings[0], &mouse_options_decoded));
 
   EXPECT_EQ(mouse_options_decoded.protocol, PROTO_MS2BUTTON);
-  EXPECT_EQ(mouse_options_decoded.sensitivity, 1.0);
+  EXPECT_EQ(mouse_options_decoded.sensitivity, SENSITIVITY_ONE);
   EXPECT_EQ(mouse_options_decoded.swap_buttons, true);
   EXPECT_EQ(mouse_options_decoded.wheel, true);
 }
+
+TEST_F(SettingsTest, EncodeDecodeCarrySucceeds) {
+
+  mouse_opts_t mouse_options = {};
+  uint8_t binary_settings[SETTINGS_SIZE];
+
+  mouse_options.protocol = PROTO_MSWHEEL;
+  mouse_options.sensitivity = SENSITIVITY_ONE;
+  mouse_options.motion_carry = true;
+  mouse_options.carry_decay = CARRY_DECAY_STOP;
+  mouse_options.carry_cap = 3;
+  mouse_options.accel_curve = ACCEL_POWER;
+  mouse_options.wheel_short = true;
+
+  settings_encode(&binary_settings[0], &mouse_options);
+
+  mouse_opts_t mouse_options_decoded;
+  EXPECT_TRUE(settings_decode(&binary_settings[0], &mouse_options_decoded));
+
+  EXPECT_EQ(mouse_options_decoded.motion_carry, true);
+  EXPECT_EQ(mouse_options_decoded.carry_decay, CARRY_DECAY_STOP);
+  EXPECT_EQ(mouse_options_decoded.carry_cap, 3);
+  EXPECT_EQ(mouse_options_decoded.accel_curve, ACCEL_POWER);
+  EXPECT_EQ(mouse_options_decoded.wheel_short, true);
+}
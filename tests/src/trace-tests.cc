@@ -0,0 +1,113 @@
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+extern "C" {
+  #include "../../linux/src/include/trace.h"
+  #include "../../shared/mouse.h"
+}
+
+class TraceTest : public testing::Test {
+  protected:
+
+  char path[32];
+  trace_map_t map;
+
+  // Per-test set-up logic as usual.
+  void SetUp() override {
+    strcpy(path, "/tmp/amouse-trace-XXXXXX");
+    close(mkstemp(path));
+    memset(&map, 0, sizeof(map));
+    g_mouse_options.protocol = PROTO_MSWHEEL;
+    g_mouse_options.sensitivity = SENSITIVITY_ONE;
+    g_mouse_options.accel_curve = ACCEL_CUSTOM;
+    g_mouse_options.accel_points_num = 2;
+    g_mouse_options.accel_points[0] = { 0, SENSITIVITY_ONE / 2 };
+    g_mouse_options.accel_points[1] = { 40, 2 * SENSITIVITY_ONE };
+  }
+ 
+  // Per-test tear-down logic
+  void TearDown() override {
+    trace_unmap(&map);
+    unlink(path);
+    g_mouse_options.accel_curve = ACCEL_LINEAR;
+    g_mouse_options.accel_points_num = 0;
+  }
+
+ };
+
+
+/*** Trace file ***/
+
+TEST_F(TraceTest, RecordsRoundTrip) {
+  mouse_frame_t frame = { -3, 120, 1, 1, -1, 0 };
+  uint8_t packet[4] = { 0x60, 0x3d, 0x38, 0x01 };
+
+  FILE *trace = trace_create(path, &g_mouse_options);
+  ASSERT_NE(trace, nullptr);
+  trace_write_ident(trace, 1000);
+  trace_write_frame(trace, 2000, &frame);
+  trace_write_packet(trace, 3000, packet, sizeof(packet));
+  fclose(trace);
+
+  ASSERT_TRUE(trace_map(path, &map));
+  ASSERT_EQ(map.count, 3u);
+  EXPECT_EQ(map.records[0].type, TRACE_IDENT);
+  EXPECT_EQ(map.records[1].time_ns, 2000u);
+
+  mouse_frame_t replayed;
+  trace_frame(&map.records[1], &replayed);
+  EXPECT_EQ(replayed.x, -3);
+  EXPECT_EQ(replayed.y, 120);
+  EXPECT_EQ(replayed.wheel, 1);
+  EXPECT_EQ(replayed.lmb, 1);
+  EXPECT_EQ(replayed.rmb, -1);
+  EXPECT_EQ(replayed.mmb, 0);
+
+  EXPECT_EQ(map.records[2].type, TRACE_PACKET);
+  ASSERT_EQ(map.records[2].len, 4);
+  EXPECT_EQ(memcmp(map.records[2].packet, packet, sizeof(packet)), 0);
+}
+
+TEST_F(TraceTest, HeaderKeepsOptions) {
+  FILE *trace = trace_create(path, &g_mouse_options);
+  ASSERT_NE(trace, nullptr);
+  fclose(trace);
+
+  mouse_opts_t options = {0};
+  ASSERT_TRUE(trace_map(path, &map));
+  EXPECT_EQ(map.count, 0u);
+  ASSERT_TRUE(trace_options(map.header, &options));
+  EXPECT_EQ(options.protocol, (uint)PROTO_MSWHEEL);
+  EXPECT_EQ(options.accel_curve, ACCEL_CUSTOM);
+  EXPECT_EQ(options.accel_points_num, 2);
+  EXPECT_EQ(options.accel_points[1].speed, 40);
+  EXPECT_EQ(options.accel_points[1].gain, 2 * SENSITIVITY_ONE);
+}
+
+// Settings round sensitivity to 0.2 steps, replay needs the tenths given with -r
+TEST_F(TraceTest, KeepsExactSensitivity) {
+  g_mouse_options.sensitivity = SENSITIVITY_ONE * 11 / 10;
+  FILE *trace = trace_create(path, &g_mouse_options);
+  ASSERT_NE(trace, nullptr);
+  g_mouse_options.sensitivity = SENSITIVITY_ONE * 13 / 10;
+  trace_write_settings(trace, 1000, &g_mouse_options);
+  fclose(trace);
+
+  mouse_opts_t options = {0};
+  ASSERT_TRUE(trace_map(path, &map));
+  ASSERT_TRUE(trace_options(map.header, &options));
+  EXPECT_EQ(options.sensitivity, SENSITIVITY_ONE * 11 / 10);
+
+  ASSERT_EQ(map.count, 1u);
+  ASSERT_TRUE(trace_record_options(&map.records[0], &options));
+  EXPECT_EQ(options.sensitivity, SENSITIVITY_ONE * 13 / 10);
+}
+
+TEST_F(TraceTest, RejectsForeignFile) {
+  FILE *file = fopen(path, "wb");
+  for(int i=0; i < 64; i++) { fputc('x', file); }
+  fclose(file);
+
+  EXPECT_FALSE(trace_map(path, &map));
+  EXPECT_EQ(map.base, nullptr);
+}
@@ -0,0 +1,130 @@
+#include <gtest/gtest.h>
+#include <thread>
+
+extern "C" {
+  #include "../../shared/txring.h"
+}
+
+class TxRingTest : public testing::Test {
+  protected:
+
+  tx_ring_t ring;
+
+  // Per-test set-up logic as usual.
+  void SetUp() override {
+    tx_ring_init(&ring);
+  }
+ 
+  // Per-test tear-down logic
+  void TearDown() override {  }
+
+  // Claim, fill and publish as the firmware does, false if the ring is full.
+  bool push(const void *data, int len, int type) {
+    tx_chunk_t *chunk = tx_ring_claim(&ring);
+    if(chunk == NULL) { return false; }
+    memcpy(chunk->data, data, len);
+    tx_ring_publish(&ring, len, type);
+    return true;
+  }
+
+ };
+
+
+/*** Ring ***/
+
+TEST_F(TxRingTest, ChunksComeOutInOrder) {
+  uint8_t packet1[3] = { 0x40, 0x01, 0x02 };
+  uint8_t packet2[4] = { 0x60, 0x00, 0x00, 0x10 };
+
+  EXPECT_TRUE(tx_ring_empty(&ring));
+  ASSERT_TRUE(push(packet1, sizeof(packet1), TX_CHUNK_PACKET));
+  ASSERT_TRUE(push(packet2, sizeof(packet2), TX_CHUNK_TEXT));
+  EXPECT_EQ(tx_ring_level(&ring), 2u);
+
+  tx_chunk_t const *chunk = tx_ring_peek(&ring);
+  ASSERT_NE(chunk, nullptr);
+  EXPECT_EQ(chunk->len, 3);
+  EXPECT_EQ(chunk->type, TX_CHUNK_PACKET);
+  EXPECT_EQ(memcmp(chunk->data, packet1, 3), 0);
+  tx_ring_release(&ring);
+
+  chunk = tx_ring_peek(&ring);
+  ASSERT_NE(chunk, nullptr);
+  EXPECT_EQ(chunk->len, 4);
+  EXPECT_EQ(chunk->type, TX_CHUNK_TEXT);
+  tx_ring_release(&ring);
+
+  EXPECT_EQ(tx_ring_peek(&ring), nullptr);
+}
+
+TEST_F(TxRingTest, FullRingRefusesUntilReleased) {
+  uint8_t byte = 0x55;
+  for(int i=0; i < TX_RING_SIZE; i++) { ASSERT_TRUE(push(&byte, 1, TX_CHUNK_PACKET)); }
+  EXPECT_FALSE(push(&byte, 1, TX_CHUNK_PACKET));
+  EXPECT_EQ(tx_ring_claim(&ring), nullptr);
+
+  tx_ring_peek(&ring);
+  tx_ring_release(&ring);
+  EXPECT_TRUE(push(&byte, 1, TX_CHUNK_PACKET));
+}
+
+// Only a waiting chunk of the asked type comes back, never the one being sent
+TEST_F(TxRingTest, RetractWaitingMotion) {
+  uint8_t motion[3] = { 0x40, 0x01, 0x02 };
+  uint8_t buttons[3] = { 0x60, 0x00, 0x00 };
+
+  ASSERT_TRUE(push(motion, sizeof(motion), TX_CHUNK_MOTION));
+  EXPECT_FALSE(tx_ring_retract(&ring, TX_CHUNK_MOTION)); // Oldest, may be in flight
+
+  ASSERT_TRUE(push(buttons, sizeof(buttons), TX_CHUNK_PACKET));
+  EXPECT_FALSE(tx_ring_retract(&ring, TX_CHUNK_MOTION)); // Button change stays
+
+  ASSERT_TRUE(push(motion, sizeof(motion), TX_CHUNK_MOTION));
+  EXPECT_TRUE(tx_ring_retract(&ring, TX_CHUNK_MOTION));
+  EXPECT_EQ(tx_ring_level(&ring), 2u);
+
+  tx_ring_release(&ring);
+  tx_chunk_t const *chunk = tx_ring_peek(&ring);
+  ASSERT_NE(chunk, nullptr);
+  EXPECT_EQ(chunk->type, TX_CHUNK_PACKET);
+  tx_ring_release(&ring);
+  EXPECT_EQ(tx_ring_peek(&ring), nullptr);
+}
+
+TEST_F(TxRingTest, CountersWrap) {
+  uint8_t byte = 0;
+  ring.head = ring.tail = UINT32_MAX - 2;
+  for(int i=0; i < 6; i++) {
+    ASSERT_TRUE(push(&byte, 1, TX_CHUNK_PACKET));
+    EXPECT_EQ(tx_ring_level(&ring), 1u);
+    ASSERT_NE(tx_ring_peek(&ring), nullptr);
+    tx_ring_release(&ring);
+  }
+  EXPECT_TRUE(tx_ring_empty(&ring));
+}
+
+TEST_F(TxRingTest, ProducerConsumerThreads) {
+  const int chunks = 20000;
+  uint32_t received = 0;
+  bool in_order = true;
+
+  std::thread consumer([&]() {
+    while(received < chunks) {
+      tx_chunk_t const *chunk = tx_ring_peek(&ring);
+      if(chunk == nullptr) { std::this_thread::yield(); continue; }
+      uint32_t value;
+      memcpy(&value, chunk->data, sizeof(value));
+      if(value != received || chunk->len != sizeof(value)) { in_order = false; }
+      received++;
+      tx_ring_release(&ring);
+    }
+  });
+
+  for(uint32_t i=0; i < chunks; i++) {
+    while(!push(&i, sizeof(i), TX_CHUNK_PACKET)) { std::this_thread::yield(); }
+  }
+  consumer.join();
+
+  EXPECT_EQ(received, (uint32_t)chunks);
+  EXPECT_TRUE(in_order);
+}